@@ -10,32 +10,124 @@
 #include <iostream>
 #include <random>
 #include <string>
+#include <vector>
 
+#include "app/benchmark.hpp"
+#include "assets/asset_streamer.hpp"
+#include "app/fixed_timestep.hpp"
 #include "cameras/arcball_camera.hpp"
 #include "cameras/fps_camera.hpp"
+#include "concurrency/job_system.hpp"
 #include "input_handlers/arcball_input_handler.hpp"
 #include "input_handlers/fps_input_handler.hpp"
+#include "input_handlers/input_recording.hpp"
+#include "memory/frame_allocator.hpp"
+#include "memory/object_pool.hpp"
+#include "physics/physics_world.hpp"
+#include "profiler/gpu_timer.hpp"
+#include "profiler/profiler.hpp"
+#include "renderer/camera_uniform_buffer.hpp"
+#include "renderer/command_list.hpp"
+#include "renderer/geometry_arena.hpp"
+#include "renderer/indirect_draw_buffer.hpp"
+#include "renderer/instance_buffer.hpp"
+#include "renderer/radix_sort.hpp"
+#include "renderer/render_queue.hpp"
+#include "renderer/stream_buffer.hpp"
+#include "scene/bvh.hpp"
+#include "scene/frustum.hpp"
+#include "scene/occlusion_culler.hpp"
+#include "scene/transform_system.hpp"
 #include "shader/shader.hpp"
-
-// Test bullet3 includes
-#include "btBulletDynamicsCommon.h"
+#include "shader/shader_watcher.hpp"
+#include "terrain/terrain.hpp"
 
 class App {
   public:
     enum class CameraType { FPS, Arcball };
 
+    // cubes are laid out on a CUBE_GRID_SIZE x CUBE_GRID_SIZE grid
+    static constexpr int CUBE_GRID_SIZE = 100;
+    static constexpr float CUBE_HALF_EXTENT = 0.2f;
+    // seeds the cube layout of headless, recorded and replayed runs
+    static constexpr uint32_t CUBE_LAYOUT_SEED = 12345;
+    static constexpr float CUBE_BOUNDING_RADIUS = CUBE_HALF_EXTENT * 1.7320508f;
+    // the nearest visible cubes occlude the ones behind them
+    static constexpr size_t MAX_CUBE_OCCLUDERS = 256;
+
+    // Converted from assets/*.obj by tools/mesh_converter at build time
+    static constexpr const char *CUBE_MESH_PATH = "assets/cube.mesh";
+    // Assets load in the background and are handed to GL within this budget per frame
+    static constexpr unsigned int ASSET_LOADER_THREADS = 2;
+    static constexpr double ASSET_UPLOAD_BUDGET_SECONDS = 0.002;
+    // Terrain chunks are uploaded within this budget per frame
+    static constexpr double TERRAIN_UPLOAD_BUDGET_SECONDS = 0.002;
+    // Must match the format mesh_converter writes (see CMakeLists.txt)
+    static constexpr MeshVertexLayout GEOMETRY_VERTEX_LAYOUT = MeshVertexLayout::Snorm16PositionNormalColor;
+    // Initial size of the shared geometry buffers; they grow as needed
+    static constexpr uint32_t GEOMETRY_VERTEX_CAPACITY = 64 * 1024;
+    static constexpr uint32_t GEOMETRY_INDEX_CAPACITY = 256 * 1024;
+    static constexpr size_t MAX_DRAW_COMMANDS = 1024;
+    // Per-frame scratch memory to start with; it grows to the peak frame
+    static constexpr size_t FRAME_MEMORY_BYTES = 1024 * 1024;
+
+    static constexpr float NEAR_PLANE = 0.1f;
+    static constexpr float FAR_PLANE = 200.0f;
+
     App(int width, int height, const std::string &title,
-        const char *vertexShader, const char *fragmentShader);
-    ~App();
+        const char *vertexShader, const char *fragmentShader,
+        const char *instancedVertexShader);
+
+    // Must be called before Initialize()
+    void SetHeadless(const HeadlessSettings &settings);
+    // Enables the profiler; the trace and summary are written to
+    // <basePath>.json and <basePath>.csv on exit
+    void SetProfileOutput(const std::string &basePath);
+    // Simulation rate of Update(), independent of the frame rate
+    void SetTickRate(double ticksPerSecond);
+    // Records the input of a windowed run, with each frame's duration
+    bool SetInputRecording(const std::string &path);
+    // Replays a recording instead of live input, advancing every frame by
+    // its recorded duration. Headless runs replay it in place of the
+    // scripted camera. Must be called before Initialize().
+    bool SetInputReplay(const std::string &path);
 
     bool Initialize();
     void Run();
 
   private:
+    bool InitWindow();
+    bool InitHeadlessContext();
+    void InitOffscreenTarget();
+    void RunBenchmark();
+    void ScriptCamera(float time);
+    void EndProfilerFrame();
+    void WriteProfile();
     void GetOpenGLVersionInfo();
     void InitOpenGL();
-    void ProcessInput();
-    void Update();
+    void ConfigureShader(Shader *program);
+    void ReloadChangedShaders();
+    void InitCubeInstances();
+    void InitPhysics();
+    void InitScene();
+    void UploadPhysicsTransforms(const PhysicsSnapshot &snapshot);
+    void RefitCubeBounds(const PhysicsSnapshot &snapshot);
+    void SortVisibleCubes(const glm::vec3 &eye);
+    glm::mat4 CubeModelMatrix(const PhysicsSnapshot &snapshot, uint32_t cube) const;
+    // Run on job threads: the objects are culled against the frustum, then
+    // against the occluders, then their draws are recorded
+    void CullCubes(const PhysicsSnapshot &snapshot, const Frustum &frustum, const glm::vec3 &eye);
+    void CullTerrain(const Frustum &frustum);
+    void CullOccludedObjects(const PhysicsSnapshot &snapshot, const glm::mat4 &viewProjection);
+    void RecordCubeCommands(const glm::vec3 &eye);
+    void RecordTerrainCommands(const glm::vec3 &eye);
+    glm::vec3 CameraPosition() const;
+    void StreamTerrain(bool wait);
+    void ProcessInput(double &frameSeconds);
+    void HandleEvent(const SDL_Event &e);
+    bool IsDeterministic() const;
+    void Simulate(double frameSeconds);
+    void Update(float tickDelta);
     void Render();
     void SwitchCamera();
     void UpdateViewport(const int &width, const int &height);
@@ -47,25 +139,111 @@ class App {
 
     const char *vertexShaderPath;
     const char *fragmentShaderPath;
+    const char *instancedVertexShaderPath;
 
+    // deltaTime is the duration of the last frame; the simulation itself
+    // advances in fixed ticks of timestep.TickDelta()
     float deltaTime;
-    float lastFrame;
+    Uint64 lastCounter;
+    FixedTimestep timestep;
+    float renderAlpha;
+    // Runs the CPU side of the update and of draw preparation across all
+    // cores; GL calls stay on the main thread
+    JobSystem jobs;
+    // Scratch memory for data that lives for a frame; reset as frames begin
+    FrameAllocator frameMemory;
+    // Composition of the scene transforms, started at the end of the update
+    // and waited for by the render
+    JobCounter sceneComposed;
+    Interpolated<glm::vec3> fpsCameraPosition;
 
     SDL_Window *window;
     SDL_GLContext context;
     bool quit;
 
-    unsigned int cubeVAO, cubeVBO, cubeEBO;
-    unsigned int planeVAO, planeVBO, planeEBO;
+    // Headless mode: EGL display/context (kept opaque here) and offscreen target
+    HeadlessSettings headless;
+    void *eglDisplay;
+    void *eglContext;
+    unsigned int offscreenFBO, offscreenColorRBO, offscreenDepthRBO;
+    FrameStats frameStats;
+
+    std::string profileOutputPath;
+    GpuTimer gpuTimer;
+
+    // Meshes and shaders stay empty/null until the streamer delivers them.
+    // Every mesh is suballocated from the one geometry arena.
+    AssetStreamer assets;
+    GeometryArena geometry;
+    ArenaMesh cubeMesh;
+    // The ground, generated in chunks around the camera
+    Terrain terrain;
+    std::vector<const ArenaMesh *> visibleTerrainChunks;
+    std::vector<const std::vector<glm::vec3> *> terrainOccluders;
+    StreamBuffer frameStream;
+    IndirectDrawBuffer indirectDraws;
+    // Each frame's draws, recorded per scene partition on the job threads,
+    // then merged and sorted by state and depth before submission
+    CommandList cubeCommands;
+    CommandList terrainCommands;
+    RenderQueue renderQueue;
+    uint16_t cubeMaterial;
+    ProgramBinaryCache programBinaryCache;
+    ObjectPool<Shader, 16> programs;
     Shader *shader;
+    Shader *instancedShader;
+    // Windowed runs rebuild programs whose sources change on disk
+    ShaderWatcher shaderWatcher;
+    std::vector<std::string> changedShaderFiles;
+    int modelLocation;
+    // Where each program takes the mesh dequantization
+    struct PositionLocations {
+        int offset = -1;
+        int scale = -1;
+    };
+    PositionLocations shaderPositionLocations;
+    PositionLocations instancedShaderPositionLocations;
+
+    CameraUniformBuffer cameraUniforms;
+    // The camera matrices last uploaded, and the frustum extracted from them
+    const CameraMatrices *uploadedCamera;
+    uint64_t uploadedCameraVersion;
+    Frustum cameraFrustum;
+    // Hides what the nearby hills and cubes cover, after frustum culling
+    OcclusionCuller occlusion;
+
+    // Transforms of the non-physical scene objects
+    TransformSystem scene;
+    int terrainEntity;
+
+    // Every cube is a rigid body; body i drives cube instance i
+    PhysicsWorld physics;
+    // the physics tick each copy of the instance buffer was last written at
+    uint64_t uploadedPhysicsTicks[InstanceBuffer::FRAMES];
+
+    // initial cube transforms; physics owns them once the simulation runs
+    std::vector<InstanceData> cubeInstances;
+    InstanceBuffer cubeInstanceBuffer;
+    static constexpr unsigned int INSTANCE_DATA_TEXTURE_UNIT = 0;
+
+    // Frustum culling of the cubes
+    BoundingVolumeHierarchy cubeBVH;
+    uint64_t cubeBoundsTick;
+    std::vector<uint32_t> visibleCubeIndices;
+    VisibleInstanceList visibleCubes;
 
     FPSCamera fpsCamera;
-    InputHandler *fpsInputHandler;
+    FPSInputHandler fpsInputHandler;
     ArcballCamera arcballCamera;
-    InputHandler *arcballInputHandler;
+    ArcballInputHandler arcballInputHandler;
 
     CameraType activeCameraType;
     InputHandler *activeInputHandler;
+
+    // Events of the current frame, live or replayed
+    std::vector<SDL_Event> frameEvents;
+    InputRecorder inputRecorder;
+    InputReplay inputReplay;
 };
 
 #endif // APP_HPP
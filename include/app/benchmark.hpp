@@ -0,0 +1,113 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+// Settings of the headless mode: render offscreen for a fixed number of
+// frames with a fixed timestep, then report frame-time statistics.
+struct HeadlessSettings {
+    bool enabled = false;
+    int frames = 600;
+    float timestep = 1.0f / 60.0f;
+};
+
+// Work submitted during a single frame
+struct FrameStats {
+    unsigned int drawCalls = 0;
+    unsigned long long triangles = 0;
+    // GL state calls made and skipped as redundant by GLStateCache
+    unsigned long long stateChanges = 0;
+    unsigned long long stateChangesElided = 0;
+    // bytes taken from the per-frame allocator, and how many of them it had
+    // to fall back to the heap for
+    unsigned long long frameMemoryBytes = 0;
+    unsigned long long frameMemoryHeapBytes = 0;
+    // objects that passed frustum culling but were hidden by occluders, and
+    // the occluder triangles rasterized to find them
+    unsigned long long occludedObjects = 0;
+    unsigned long long occluderTriangles = 0;
+
+    void Reset() {
+        drawCalls = 0;
+        triangles = 0;
+        stateChanges = 0;
+        stateChangesElided = 0;
+        frameMemoryBytes = 0;
+        frameMemoryHeapBytes = 0;
+        occludedObjects = 0;
+        occluderTriangles = 0;
+    }
+};
+
+// Collects per-frame timings and submission counters over a benchmark run
+class FrameTimeRecorder {
+  public:
+    void Reserve(int frames) { frameTimes.reserve(frames); }
+
+    void Record(double milliseconds, const FrameStats &stats) {
+        frameTimes.push_back(milliseconds);
+        totalDrawCalls += stats.drawCalls;
+        totalTriangles += stats.triangles;
+        totalStateChanges += stats.stateChanges;
+        totalStateChangesElided += stats.stateChangesElided;
+        peakFrameMemoryBytes = std::max(peakFrameMemoryBytes, stats.frameMemoryBytes);
+        peakFrameMemoryHeapBytes = std::max(peakFrameMemoryHeapBytes, stats.frameMemoryHeapBytes);
+        totalOccludedObjects += stats.occludedObjects;
+        totalOccluderTriangles += stats.occluderTriangles;
+    }
+
+    // nearest-rank percentile, p in [0, 100]
+    double Percentile(double p) const {
+        if (frameTimes.empty()) {
+            return 0.0;
+        }
+        std::vector<double> sorted = frameTimes;
+        std::sort(sorted.begin(), sorted.end());
+        size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    }
+
+    void Report(std::ostream &out) const {
+        size_t frames = std::max<size_t>(frameTimes.size(), 1);
+        double total = 0.0;
+        for (double t : frameTimes) {
+            total += t;
+        }
+
+        out << "=============================================================" << std::endl;
+        out << std::fixed << std::setprecision(3);
+        out << "Frames: " << frameTimes.size() << std::endl;
+        out << "Frame time mean: " << total / frames << " ms" << std::endl;
+        out << "Frame time p50: " << Percentile(50.0) << " ms" << std::endl;
+        out << "Frame time p95: " << Percentile(95.0) << " ms" << std::endl;
+        out << "Frame time p99: " << Percentile(99.0) << " ms" << std::endl;
+        out << "Frame time max: " << Percentile(100.0) << " ms" << std::endl;
+        out << "Draw calls per frame: " << double(totalDrawCalls) / frames << std::endl;
+        out << "Triangles per frame: " << double(totalTriangles) / frames << std::endl;
+        out << "State changes per frame: " << double(totalStateChanges) / frames
+            << " (" << double(totalStateChangesElided) / frames << " redundant ones elided)" << std::endl;
+        out << "Frame memory peak: " << peakFrameMemoryBytes << " bytes (at most " << peakFrameMemoryHeapBytes
+            << " bytes per frame fell back to the heap)" << std::endl;
+        out << "Occluded objects per frame: " << double(totalOccludedObjects) / frames << " (by "
+            << double(totalOccluderTriangles) / frames << " occluder triangles)" << std::endl;
+        out << "=============================================================" << std::endl;
+        out << std::defaultfloat;
+    }
+
+  private:
+    std::vector<double> frameTimes;
+    unsigned long long totalDrawCalls = 0;
+    unsigned long long totalTriangles = 0;
+    unsigned long long totalStateChanges = 0;
+    unsigned long long totalStateChangesElided = 0;
+    unsigned long long peakFrameMemoryBytes = 0;
+    unsigned long long peakFrameMemoryHeapBytes = 0;
+    unsigned long long totalOccludedObjects = 0;
+    unsigned long long totalOccluderTriangles = 0;
+};
+
+#endif // BENCHMARK_HPP
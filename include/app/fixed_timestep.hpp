@@ -0,0 +1,73 @@
+#ifndef FIXED_TIMESTEP_HPP
+#define FIXED_TIMESTEP_HPP
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+// Accumulator-based fixed timestep. Frame time is fed in, and the number of
+// simulation ticks to run is handed back; the leftover fraction of a tick is
+// exposed as an interpolation factor for rendering.
+class FixedTimestep {
+  public:
+    explicit FixedTimestep(double tickRate = 120.0, int maxStepsPerFrame = 8) {
+        SetTickRate(tickRate);
+        SetMaxStepsPerFrame(maxStepsPerFrame);
+    }
+
+    void SetTickRate(double tickRate) { tickDelta = 1.0 / tickRate; }
+    void SetMaxStepsPerFrame(int steps) { maxSteps = steps > 0 ? steps : 1; }
+
+    double TickDelta() const { return tickDelta; }
+
+    // Adds the elapsed frame time and returns how many ticks to simulate.
+    // When more than maxSteps ticks are owed (a hitch, a debugger break, or a
+    // frame that simply cannot keep up), the backlog is dropped instead of
+    // carried over, so slow frames never snowball into slower ones.
+    int Advance(double frameSeconds) {
+        accumulator += frameSeconds;
+
+        int steps = 0;
+        while (accumulator >= tickDelta && steps < maxSteps) {
+            accumulator -= tickDelta;
+            ++steps;
+        }
+        if (accumulator >= tickDelta) {
+            double backlog = accumulator - std::fmod(accumulator, tickDelta);
+            droppedTime += backlog;
+            accumulator -= backlog;
+        }
+        return steps;
+    }
+
+    // how far the renderer is between the last two ticks, in [0, 1)
+    float Alpha() const { return static_cast<float>(accumulator / tickDelta); }
+
+    // total simulation time discarded by the catch-up cap, in seconds
+    double DroppedTime() const { return droppedTime; }
+
+  private:
+    double tickDelta = 1.0 / 120.0;
+    int maxSteps = 8;
+    double accumulator = 0.0;
+    double droppedTime = 0.0;
+};
+
+// State sampled at the last two ticks, blended at render time
+template <typename T> struct Interpolated {
+    T previous{};
+    T current{};
+
+    // records the state at the end of a tick
+    void Push(const T &value) {
+        previous = current;
+        current = value;
+    }
+
+    // jumps without blending, e.g. after a teleport
+    void Reset(const T &value) { previous = current = value; }
+
+    T Get(float alpha) const { return glm::mix(previous, current, alpha); }
+};
+
+#endif // FIXED_TIMESTEP_HPP
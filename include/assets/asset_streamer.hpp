@@ -0,0 +1,252 @@
+#ifndef ASSET_STREAMER_HPP
+#define ASSET_STREAMER_HPP
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrency/bounded_queue.hpp"
+#include "mesh/mapped_mesh.hpp"
+#include "profiler/profiler.hpp"
+#include "renderer/geometry_arena.hpp"
+#include "shader/shader.hpp"
+
+// Loads assets without stalling the frame loop. A pool of loader threads
+// reads mesh files and shader sources from disk; the results go through a
+// bounded queue to the GL thread, which turns them into GL objects in
+// ProcessUploads() under a per-frame time budget. Meshes are placed in a
+// GeometryArena. Each asset's callback runs
+// on the GL thread once it is ready, so objects appear as they arrive.
+class AssetStreamer {
+  public:
+    using MeshReadyCallback = std::function<void(const ArenaMesh &mesh)>;
+    using ShaderReadyCallback = std::function<void(const ShaderSources &sources)>;
+
+    // Buffer uploads are split into slices of this size, so a single large
+    // mesh is spread over several frames instead of blowing the budget
+    static constexpr size_t UPLOAD_SLICE_BYTES = 256 * 1024;
+    // Loaded assets waiting for the GL thread; loaders block beyond this
+    static constexpr size_t READY_QUEUE_CAPACITY = 8;
+
+    AssetStreamer() : ready(READY_QUEUE_CAPACITY) {}
+    ~AssetStreamer() { Stop(); }
+
+    void Start(unsigned int loaderCount, GeometryArena *geometry) {
+        if (!loaders.empty()) {
+            return;
+        }
+        arena = geometry;
+        stopping = false;
+        for (unsigned int i = 0; i < std::max(loaderCount, 1u); i++) {
+            loaders.emplace_back(&AssetStreamer::LoaderMain, this, i);
+        }
+    }
+
+    // Abandons whatever is still queued; must run before the GL context goes away
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(requestsMutex);
+            stopping = true;
+        }
+        requestsReady.notify_all();
+        ready.Close();
+        for (std::thread &loader : loaders) {
+            loader.join();
+        }
+        loaders.clear();
+        // a partly uploaded mesh just leaves unused space in the arena
+        upload = MeshUpload();
+    }
+
+    void LoadMesh(const std::string &path, MeshReadyCallback onReady) {
+        LoadRequest request;
+        request.kind = AssetKind::Mesh;
+        request.paths[0] = path;
+        request.onMeshReady = std::move(onReady);
+        Enqueue(std::move(request));
+    }
+
+    void LoadShader(const std::string &vertexPath, const std::string &fragmentPath, ShaderReadyCallback onReady) {
+        LoadRequest request;
+        request.kind = AssetKind::Shader;
+        request.paths[0] = vertexPath;
+        request.paths[1] = fragmentPath;
+        request.onShaderReady = std::move(onReady);
+        Enqueue(std::move(request));
+    }
+
+    // GL thread: hands loaded assets over until the budget is spent. At
+    // least one step is taken per call, so loading always makes progress.
+    void ProcessUploads(double budgetSeconds) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(budgetSeconds);
+        do {
+            if (!Step(false)) {
+                return;
+            }
+        } while (std::chrono::steady_clock::now() < deadline);
+    }
+
+    // GL thread: blocks until every asset requested so far has been handed over
+    void Flush() {
+        while (Pending() > 0 && Step(true)) {
+        }
+    }
+
+    // Assets requested but not handed over yet
+    int Pending() const { return pending.load(std::memory_order_acquire); }
+
+  private:
+    enum class AssetKind { Mesh, Shader };
+
+    struct LoadRequest {
+        AssetKind kind = AssetKind::Mesh;
+        std::string paths[2];
+        MeshReadyCallback onMeshReady;
+        ShaderReadyCallback onShaderReady;
+    };
+
+    struct LoadedAsset {
+        AssetKind kind = AssetKind::Mesh;
+        bool failed = false;
+        MappedMesh meshFile;
+        ShaderSources shaderSources;
+        MeshReadyCallback onMeshReady;
+        ShaderReadyCallback onShaderReady;
+    };
+
+    // The mesh currently being copied into the arena, slice by slice
+    struct MeshUpload {
+        bool active = false;
+        LoadedAsset asset;
+        ArenaMesh mesh;
+        uint64_t vertexBytesDone = 0;
+        uint32_t indicesDone = 0;
+    };
+
+    void Enqueue(LoadRequest &&request) {
+        pending.fetch_add(1, std::memory_order_acq_rel);
+        {
+            std::lock_guard<std::mutex> lock(requestsMutex);
+            requests.push_back(std::move(request));
+        }
+        requestsReady.notify_one();
+    }
+
+    void LoaderMain(unsigned int index) {
+        Profiler::Get().SetThreadName("Asset Loader " + std::to_string(index));
+        while (true) {
+            LoadRequest request;
+            {
+                std::unique_lock<std::mutex> lock(requestsMutex);
+                requestsReady.wait(lock, [this] { return stopping || !requests.empty(); });
+                if (stopping) {
+                    return;
+                }
+                request = std::move(requests.front());
+                requests.pop_front();
+            }
+
+            LoadedAsset asset;
+            asset.kind = request.kind;
+            asset.onMeshReady = std::move(request.onMeshReady);
+            asset.onShaderReady = std::move(request.onShaderReady);
+
+            if (request.kind == AssetKind::Mesh) {
+                PROFILE_ZONE("LoadMesh");
+                // On failure MappedMesh reports why; the asset is still
+                // handed over so the GL thread can account for it
+                asset.failed = !asset.meshFile.Open(request.paths[0]);
+                if (!asset.failed) {
+                    asset.meshFile.Prefetch();
+                }
+            } else {
+                PROFILE_ZONE("LoadShader");
+                asset.shaderSources = Shader::readSources(request.paths[0].c_str(), request.paths[1].c_str());
+            }
+
+            if (!ready.Push(std::move(asset))) {
+                return;
+            }
+        }
+    }
+
+    // Does one unit of GL work: finishes a shader, or uploads one slice of
+    // the current mesh. Returns false when there was nothing to do.
+    bool Step(bool wait) {
+        if (!upload.active) {
+            LoadedAsset asset;
+            bool popped = wait ? ready.Pop(asset) : ready.TryPop(asset);
+            if (!popped) {
+                return false;
+            }
+
+            if (asset.failed) {
+                pending.fetch_sub(1, std::memory_order_acq_rel);
+                return true;
+            }
+
+            if (asset.kind == AssetKind::Shader) {
+                PROFILE_ZONE("CreateShader");
+                asset.onShaderReady(asset.shaderSources);
+                pending.fetch_sub(1, std::memory_order_acq_rel);
+                return true;
+            }
+
+            upload = MeshUpload();
+            if (!arena->Allocate(asset.meshFile.Header(), upload.mesh)) {
+                pending.fetch_sub(1, std::memory_order_acq_rel);
+                return true;
+            }
+            upload.active = true;
+            upload.asset = std::move(asset);
+            return true;
+        }
+
+        PROFILE_ZONE("UploadMesh");
+        const MappedMesh &file = upload.asset.meshFile;
+        const MeshFileHeader &header = file.Header();
+        if (upload.vertexBytesDone < header.vertexBytes) {
+            uint64_t bytes = std::min<uint64_t>(UPLOAD_SLICE_BYTES, header.vertexBytes - upload.vertexBytesDone);
+            arena->UploadVertices(upload.mesh, upload.vertexBytesDone,
+                                  static_cast<const uint8_t *>(file.Vertices()) + upload.vertexBytesDone, bytes);
+            upload.vertexBytesDone += bytes;
+        } else if (upload.indicesDone < header.indexCount) {
+            uint32_t count = std::min<uint32_t>(UPLOAD_SLICE_BYTES / sizeof(uint32_t), header.indexCount - upload.indicesDone);
+            arena->UploadIndices(upload.mesh, upload.indicesDone,
+                                 static_cast<const uint32_t *>(file.Indices()) + upload.indicesDone, count);
+            upload.indicesDone += count;
+        }
+
+        if (upload.vertexBytesDone == header.vertexBytes && upload.indicesDone == header.indexCount) {
+            upload.asset.onMeshReady(upload.mesh);
+            upload = MeshUpload();
+            pending.fetch_sub(1, std::memory_order_acq_rel);
+        }
+        return true;
+    }
+
+    std::vector<std::thread> loaders;
+
+    std::deque<LoadRequest> requests;
+    std::mutex requestsMutex;
+    std::condition_variable requestsReady;
+    bool stopping = false;
+
+    BoundedQueue<LoadedAsset> ready;
+    std::atomic<int> pending{0};
+
+    // Only touched by the GL thread
+    GeometryArena *arena = nullptr;
+    MeshUpload upload;
+};
+
+#endif // ASSET_STREAMER_HPP
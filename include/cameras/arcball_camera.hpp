@@ -5,6 +5,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "camera_matrices.hpp"
+
 // Arcball camera class that processes input and calculates the corresponding
 // view matrix for use in OpenGL
 class ArcballCamera {
@@ -24,8 +26,23 @@ class ArcballCamera {
         : Position(position), Target(target), Up(up), Distance(distance),
           Zoom(zoom) {}
 
+    // sets the viewport aspect ratio and clip planes of the projection matrix
+    void SetProjection(float aspectRatio, float nearPlane, float farPlane) {
+        this->aspectRatio = aspectRatio;
+        this->nearPlane = nearPlane;
+        this->farPlane = farPlane;
+    }
+
+    // returns the cached matrices, brought up to date with the current
+    // attributes; they are only recomputed if those changed
+    CameraMatrices &Matrices() {
+        matrices.SetLookAt(Position, Target, Up);
+        matrices.SetPerspective(Zoom, aspectRatio, nearPlane, farPlane);
+        return matrices;
+    }
+
     // returns the view matrix calculated using LookAt Matrix
-    glm::mat4 GetViewMatrix() { return glm::lookAt(Position, Target, Up); }
+    const glm::mat4 &GetViewMatrix() { return Matrices().View(); }
 
     // processes input for rotating the camera around the target
     void ProcessMouseRotation(float xoffset, float yoffset) {
@@ -60,6 +77,12 @@ class ArcballCamera {
         glm::vec3 direction = glm::normalize(Position - Target);
         Position = Target + direction * Distance;
     }
+
+  private:
+    float aspectRatio = 1.0f;
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
+    CameraMatrices matrices;
 };
 
 #endif
@@ -0,0 +1,110 @@
+#ifndef CAMERA_MATRICES_HPP
+#define CAMERA_MATRICES_HPP
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstdint>
+
+// The view and projection matrices of a camera and the products derived
+// from them, recomputed only after their inputs change. The camera hands
+// over its inputs whenever they might have changed; handing over the same
+// values again is a few comparisons and keeps every matrix. Each real change
+// bumps Version(), so consumers (uniform upload, frustum extraction) can
+// remember the version they last used and skip their work while the camera
+// stands still.
+class CameraMatrices {
+  public:
+    void SetLookAt(const glm::vec3 &eye, const glm::vec3 &center, const glm::vec3 &up) {
+        if (eye == this->eye && center == this->center && up == this->up) {
+            return;
+        }
+        this->eye = eye;
+        this->center = center;
+        this->up = up;
+        viewDirty = true;
+        version++;
+    }
+
+    void SetPerspective(float fovyDegrees, float aspect, float nearPlane, float farPlane) {
+        if (fovyDegrees == this->fovyDegrees && aspect == this->aspect && nearPlane == this->nearPlane &&
+            farPlane == this->farPlane) {
+            return;
+        }
+        this->fovyDegrees = fovyDegrees;
+        this->aspect = aspect;
+        this->nearPlane = nearPlane;
+        this->farPlane = farPlane;
+        projectionDirty = true;
+        version++;
+    }
+
+    // Starts at 1, so 0 can stand for "never seen"
+    uint64_t Version() const { return version; }
+
+    const glm::vec3 &Eye() const { return eye; }
+
+    const glm::mat4 &View() {
+        Refresh();
+        return view;
+    }
+
+    const glm::mat4 &Projection() {
+        Refresh();
+        return projection;
+    }
+
+    const glm::mat4 &ViewProjection() {
+        Refresh();
+        return viewProjection;
+    }
+
+    const glm::mat4 &InverseView() {
+        Refresh();
+        return inverseView;
+    }
+
+    // Maps clip space back to the world, e.g. to cast a ray through a pixel
+    const glm::mat4 &InverseViewProjection() {
+        Refresh();
+        return inverseViewProjection;
+    }
+
+  private:
+    void Refresh() {
+        if (!viewDirty && !projectionDirty) {
+            return;
+        }
+        if (viewDirty) {
+            view = glm::lookAt(eye, center, up);
+            // a view matrix is a rigid transform, so the cheap inverse is exact
+            inverseView = glm::affineInverse(view);
+        }
+        if (projectionDirty) {
+            projection = glm::perspective(glm::radians(fovyDegrees), aspect, nearPlane, farPlane);
+        }
+        viewProjection = projection * view;
+        inverseViewProjection = glm::inverse(viewProjection);
+        viewDirty = projectionDirty = false;
+    }
+
+    glm::vec3 eye = glm::vec3(0.0f);
+    glm::vec3 center = glm::vec3(0.0f, 0.0f, -1.0f);
+    glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+    float fovyDegrees = 45.0f;
+    float aspect = 1.0f;
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
+
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    glm::mat4 inverseView = glm::mat4(1.0f);
+    glm::mat4 inverseViewProjection = glm::mat4(1.0f);
+    bool viewDirty = true;
+    bool projectionDirty = true;
+    uint64_t version = 1;
+};
+
+#endif // CAMERA_MATRICES_HPP
@@ -9,6 +9,8 @@ This is a FPS camera class pasted from learnopengl.com.
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "camera_matrices.hpp"
+
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
 enum FPSCamera_Movement {
     FORWARD,
@@ -62,10 +64,39 @@ public:
         updateCameraVectors();
     }
 
+    // sets the viewport aspect ratio and clip planes of the projection matrix
+    void SetProjection(float aspectRatio, float nearPlane, float farPlane)
+    {
+        AspectRatio = aspectRatio;
+        NearPlane = nearPlane;
+        FarPlane = farPlane;
+    }
+
+    // returns the cached matrices, brought up to date with the current attributes. They are only recomputed if
+    // the attributes changed since the last call, so this is cheap to call every frame
+    CameraMatrices &Matrices()
+    {
+        return Matrices(Position);
+    }
+
+    // the same as seen from another position, e.g. one interpolated between simulation ticks
+    CameraMatrices &Matrices(const glm::vec3 &position)
+    {
+        matrices.SetLookAt(position, position + Front, Up);
+        matrices.SetPerspective(Zoom, AspectRatio, NearPlane, FarPlane);
+        return matrices;
+    }
+
     // returns the view matrix calculated using Euler Angles and the LookAt Matrix
-    glm::mat4 GetViewMatrix()
+    const glm::mat4 &GetViewMatrix()
     {
-        return glm::lookAt(Position, Position + Front, Up);
+        return Matrices().View();
+    }
+
+    // returns the view matrix as seen from another position, e.g. one interpolated between simulation ticks
+    const glm::mat4 &GetViewMatrix(const glm::vec3 &position)
+    {
+        return Matrices(position).View();
     }
 
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
@@ -115,6 +146,12 @@ public:
     }
 
 private:
+    // projection options
+    float AspectRatio = 1.0f;
+    float NearPlane = 0.1f;
+    float FarPlane = 100.0f;
+    CameraMatrices matrices;
+
     // calculates the front vector from the Camera's (updated) Euler Angles
     void updateCameraVectors()
     {
@@ -0,0 +1,67 @@
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+// Multi-producer multi-consumer FIFO with a fixed capacity. Producers block
+// while it is full, which keeps fast producers from running arbitrarily far
+// ahead of a slow consumer. Close() wakes everyone up for shutdown.
+template <typename T>
+class BoundedQueue {
+  public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+    // Blocks while the queue is full; returns false if it was closed
+    bool Push(T &&item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Blocks while the queue is empty; returns false once it is closed and drained
+    bool Pop(T &item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        return PopLocked(item);
+    }
+
+    bool TryPop(T &item) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return PopLocked(item);
+    }
+
+    void Close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+  private:
+    bool PopLocked(T &item) {
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    const size_t capacity;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    bool closed = false;
+};
+
+#endif // BOUNDED_QUEUE_HPP
@@ -0,0 +1,327 @@
+#ifndef JOB_SYSTEM_HPP
+#define JOB_SYSTEM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "profiler/profiler.hpp"
+
+class JobCounter;
+
+// A small callable stored inline, so scheduling a job never allocates.
+// Captures must be trivially copyable (pointers, indices), which also means
+// anything a job refers to has to outlive it; callers wait on the job's
+// counter before it goes away.
+class Job {
+  public:
+    static constexpr size_t STORAGE_SIZE = 48;
+
+    template <typename Function> static Job Make(const Function &function) {
+        static_assert(sizeof(Function) <= STORAGE_SIZE, "job captures too much; capture a pointer instead");
+        static_assert(std::is_trivially_copyable_v<Function>, "job captures must be trivially copyable");
+        Job job;
+        new (job.storage) Function(function);
+        job.invoke = [](void *storage) { (*std::launder(reinterpret_cast<Function *>(storage)))(); };
+        return job;
+    }
+
+    void operator()() { invoke(storage); }
+
+  private:
+    friend class JobSystem;
+
+    alignas(16) unsigned char storage[STORAGE_SIZE];
+    void (*invoke)(void *storage) = nullptr;
+    JobCounter *counter = nullptr;
+};
+
+// Counts the unfinished jobs of a group. It is the edge type of the job
+// graph: jobs can be made to wait for a counter, and are only queued once
+// it reaches zero. A counter can be reused once it has reached zero.
+class JobCounter {
+  public:
+    JobCounter() = default;
+    JobCounter(const JobCounter &) = delete;
+    JobCounter &operator=(const JobCounter &) = delete;
+
+    bool Done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+  private:
+    friend class JobSystem;
+
+    // Continuations are stored inline up to this many, so counters that
+    // live on the stack for a frame never allocate; the rest spill to the heap
+    static constexpr size_t INLINE_CONTINUATIONS = 4;
+
+    void AddContinuation(const Job &job) {
+        if (continuationCount < INLINE_CONTINUATIONS) {
+            continuations[continuationCount++] = job;
+        } else {
+            spilledContinuations.push_back(job);
+        }
+    }
+
+    std::atomic<uint32_t> pending{0};
+    // jobs waiting for this counter, queued when it reaches zero
+    std::mutex mutex;
+    Job continuations[INLINE_CONTINUATIONS];
+    size_t continuationCount = 0;
+    std::vector<Job> spilledContinuations;
+};
+
+// Work-stealing job scheduler. Every worker, and the thread that started
+// the system (the main thread, slot 0), owns a queue: it pushes and pops
+// its own jobs at the back, which keeps recently touched data in its cache,
+// while idle workers steal the oldest jobs from the front of the others.
+// Threads waiting for a counter run jobs instead of blocking, so the main
+// thread takes part in its own parallel work.
+class JobSystem {
+  public:
+    JobSystem() = default;
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+    ~JobSystem() { Stop(); }
+
+    // Starts workerCount worker threads; with none, every job runs on the
+    // thread that waits for it
+    void Start(unsigned int workerCount) {
+        if (!queues) {
+            queueCount = workerCount + 1;
+            queues = std::make_unique<WorkQueue[]>(queueCount);
+            stopping = false;
+            ThreadSlot() = 0;
+            for (unsigned int i = 1; i < queueCount; i++) {
+                workers.emplace_back(&JobSystem::WorkerMain, this, i);
+            }
+        }
+    }
+
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+        queues.reset();
+        queueCount = 0;
+    }
+
+    // Threads that run jobs, including the main thread
+    unsigned int ThreadCount() const { return std::max(queueCount, 1u); }
+
+    // Queues a job that counts towards counter. With after, the job is only
+    // queued once after reaches zero (right away if it already has).
+    template <typename Function> void Run(JobCounter &counter, const Function &function, JobCounter *after = nullptr) {
+        Job job = Job::Make(function);
+        job.counter = &counter;
+        counter.pending.fetch_add(1, std::memory_order_relaxed);
+
+        if (after) {
+            std::lock_guard<std::mutex> lock(after->mutex);
+            if (!after->Done()) {
+                after->AddContinuation(job);
+                return;
+            }
+        }
+        Push(job);
+    }
+
+    // Runs queued jobs until the counter reaches zero
+    void Wait(JobCounter &counter) {
+        while (!counter.Done()) {
+            if (!RunOne()) {
+                std::this_thread::yield();
+            }
+        }
+        // the job that finished the group may still hold the lock; once it is
+        // released the counter is free to go away
+        std::lock_guard<std::mutex> lock(counter.mutex);
+    }
+
+    // Calls function(begin, end) over subranges of [0, count) across all
+    // threads and returns once every subrange is done. Ranges are at least
+    // minRange long, so small loops stay on the calling thread.
+    template <typename Function> void ParallelFor(uint32_t count, uint32_t minRange, const Function &function) {
+        if (count == 0) {
+            return;
+        }
+        // a few ranges per thread evens out uneven work
+        uint32_t range = std::max(minRange, (count + ThreadCount() * 4 - 1) / (ThreadCount() * 4));
+        if (!queues || range >= count) {
+            function(uint32_t(0), count);
+            return;
+        }
+
+        JobCounter counter;
+        const Function *body = &function;
+        for (uint32_t begin = 0; begin < count; begin += range) {
+            uint32_t end = std::min(begin + range, count);
+            Run(counter, [body, begin, end] { (*body)(begin, end); });
+        }
+        Wait(counter);
+    }
+
+  private:
+    // A double-ended ring of jobs; grows when full, never shrinks
+    struct alignas(64) WorkQueue {
+        std::mutex mutex;
+        std::vector<Job> jobs = std::vector<Job>(256);
+        size_t head = 0;
+        size_t size = 0;
+
+        void PushBack(const Job &job) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (size == jobs.size()) {
+                std::vector<Job> grown(jobs.size() * 2);
+                for (size_t i = 0; i < size; i++) {
+                    grown[i] = jobs[(head + i) % jobs.size()];
+                }
+                jobs.swap(grown);
+                head = 0;
+            }
+            jobs[(head + size) % jobs.size()] = job;
+            size++;
+        }
+
+        bool PopBack(Job &job) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (size == 0) {
+                return false;
+            }
+            size--;
+            job = jobs[(head + size) % jobs.size()];
+            return true;
+        }
+
+        bool StealFront(Job &job) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (size == 0) {
+                return false;
+            }
+            job = jobs[head];
+            head = (head + 1) % jobs.size();
+            size--;
+            return true;
+        }
+    };
+
+    // queue slot of the calling thread; threads the system does not know
+    // (e.g. the asset loaders) share the main thread's queue
+    static unsigned int &ThreadSlot() {
+        thread_local unsigned int slot = 0;
+        return slot;
+    }
+
+    void Push(const Job &job) {
+        if (!queues) {
+            // not started: run inline
+            Job copy = job;
+            Execute(copy);
+            return;
+        }
+        queues[ThreadSlot()].PushBack(job);
+        queuedJobs.fetch_add(1);
+        if (sleepingWorkers.load() > 0) {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            wake.notify_one();
+        }
+    }
+
+    // Runs one job from the own queue, or one stolen from another
+    bool RunOne() {
+        if (!queues) {
+            return false;
+        }
+        unsigned int slot = ThreadSlot();
+        Job job;
+        bool found = queues[slot].PopBack(job);
+        for (unsigned int i = 1; !found && i < queueCount; i++) {
+            found = queues[(slot + i) % queueCount].StealFront(job);
+        }
+        if (!found) {
+            return false;
+        }
+        queuedJobs.fetch_sub(1);
+        Execute(job);
+        return true;
+    }
+
+    void Execute(Job &job) {
+        job();
+        JobCounter &counter = *job.counter;
+
+        // Jobs that cannot be the last of their group only decrement
+        uint32_t pending = counter.pending.load(std::memory_order_relaxed);
+        while (pending > 1) {
+            if (counter.pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel)) {
+                return;
+            }
+        }
+        // Reaching zero under the lock orders it against Run() checking the
+        // counter, so no continuation is parked after the release. The
+        // released jobs are copied out first: before Start() they run inline
+        // and may finish groups of their own in here.
+        Job released[JobCounter::INLINE_CONTINUATIONS];
+        size_t releasedCount = 0;
+        std::vector<Job> spilled;
+        {
+            std::lock_guard<std::mutex> lock(counter.mutex);
+            if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                releasedCount = counter.continuationCount;
+                std::copy_n(counter.continuations, releasedCount, released);
+                counter.continuationCount = 0;
+                spilled.swap(counter.spilledContinuations);
+            }
+        }
+        for (size_t i = 0; i < releasedCount; i++) {
+            Push(released[i]);
+        }
+        for (const Job &continuation : spilled) {
+            Push(continuation);
+        }
+    }
+
+    void WorkerMain(unsigned int slot) {
+        ThreadSlot() = slot;
+        Profiler::Get().SetThreadName("Job Worker " + std::to_string(slot));
+        while (true) {
+            if (RunOne()) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepingWorkers.fetch_add(1);
+            wake.wait(lock, [this] { return stopping || queuedJobs.load() > 0; });
+            sleepingWorkers.fetch_sub(1);
+            if (stopping) {
+                return;
+            }
+        }
+    }
+
+    std::unique_ptr<WorkQueue[]> queues;
+    unsigned int queueCount = 0;
+    std::vector<std::thread> workers;
+
+    // idle workers sleep until jobs are queued
+    std::atomic<uint32_t> queuedJobs{0};
+    std::atomic<uint32_t> sleepingWorkers{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+#endif // JOB_SYSTEM_HPP
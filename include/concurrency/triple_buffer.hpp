@@ -0,0 +1,56 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free triple buffer between exactly one writer thread and one reader
+// thread. The writer fills the back buffer and publishes it; the reader
+// picks up the most recently published buffer. Neither side ever waits:
+// the writer always has a buffer the reader is not looking at, and the
+// reader keeps its current buffer until a newer one has been published.
+template <typename T> class TripleBuffer {
+  public:
+    // Gives access to all three buffers, e.g. to size them up front.
+    // Only valid before the writer and reader threads start.
+    template <typename Function> void ForEach(Function function) {
+        for (T &buffer : buffers) {
+            function(buffer);
+        }
+    }
+
+    // writer side: the buffer being filled
+    T &WriteBuffer() { return buffers[backIndex]; }
+
+    // writer side: makes the back buffer the latest one and takes the
+    // previous middle buffer as the new back buffer
+    void Publish() {
+        uint8_t previous = middle.exchange(backIndex | FRESH_BIT, std::memory_order_acq_rel);
+        backIndex = previous & INDEX_MASK;
+    }
+
+    // reader side: switches to the latest published buffer, if any. Returns
+    // false when nothing new was published since the last call.
+    bool Acquire() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH_BIT)) {
+            return false;
+        }
+        uint8_t previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = previous & INDEX_MASK;
+        return true;
+    }
+
+    // reader side: the buffer last acquired
+    const T &ReadBuffer() const { return buffers[frontIndex]; }
+
+  private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t FRESH_BIT = 0x4;
+
+    T buffers[3];
+    alignas(64) uint8_t backIndex = 0;  // owned by the writer
+    alignas(64) std::atomic<uint8_t> middle{1};
+    alignas(64) uint8_t frontIndex = 2; // owned by the reader
+};
+
+#endif // TRIPLE_BUFFER_HPP
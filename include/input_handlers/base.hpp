@@ -12,6 +12,8 @@ class InputHandler {
     virtual void HandleMouseMotion(const SDL_Event &e) = 0;
     virtual void HandleMouseClick(const SDL_Event &e) = 0;
     virtual void HandleMouseWheel(const SDL_Event &e) = 0;
+    // Applies held input (e.g. movement keys) for one simulation tick
+    virtual void Update(float deltaTime) {}
 };
 
 #endif // BASE_HPP
@@ -56,7 +56,7 @@ class FPSInputHandler : public InputHandler {
         fpsCamera.ProcessMouseScroll(e.wheel.y);
     }
 
-    void Update(float deltaTime) {
+    void Update(float deltaTime) override {
         if (moveForward)
             fpsCamera.ProcessKeyboard(FORWARD, deltaTime);
         if (moveBackward)
@@ -0,0 +1,242 @@
+#ifndef INPUT_RECORDING_HPP
+#define INPUT_RECORDING_HPP
+
+#include <SDL2/SDL.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Binary input recording (.input): a header, then one record per frame
+// holding the frame's duration and the SDL events polled during it. Only
+// the event kinds and fields the app reacts to are kept, so a minute of
+// flythrough is a few hundred kilobytes. All values are little-endian.
+//
+//   [InputFileHeader] { [double seconds][uint32 count][RecordedEvent x count] }...
+
+constexpr uint32_t INPUT_MAGIC = 0x54504e49; // "INPT"
+constexpr uint32_t INPUT_VERSION = 1;
+
+struct InputFileHeader {
+    uint32_t magic;
+    uint32_t version;
+};
+
+// An SDL event reduced to its type and up to four fields, which depend on it
+struct RecordedEvent {
+    uint32_t type;
+    int32_t values[4];
+};
+
+static_assert(sizeof(RecordedEvent) == 20, "RecordedEvent is part of the file format");
+
+// Returns false for events the recording leaves out
+inline bool EncodeEvent(const SDL_Event &e, RecordedEvent &recorded) {
+    recorded = RecordedEvent();
+    recorded.type = e.type;
+    int32_t *v = recorded.values;
+    switch (e.type) {
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+        v[0] = e.key.keysym.sym;
+        v[1] = e.key.keysym.scancode;
+        v[2] = e.key.keysym.mod;
+        v[3] = e.key.repeat;
+        return true;
+    case SDL_MOUSEMOTION:
+        v[0] = e.motion.x;
+        v[1] = e.motion.y;
+        v[2] = e.motion.xrel;
+        v[3] = e.motion.yrel;
+        return true;
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+        v[0] = e.button.button;
+        v[1] = e.button.clicks;
+        v[2] = e.button.x;
+        v[3] = e.button.y;
+        return true;
+    case SDL_MOUSEWHEEL:
+        v[0] = e.wheel.x;
+        v[1] = e.wheel.y;
+        v[2] = int32_t(e.wheel.direction);
+        return true;
+    case SDL_WINDOWEVENT:
+        if (e.window.event != SDL_WINDOWEVENT_RESIZED) {
+            return false;
+        }
+        v[0] = e.window.event;
+        v[1] = e.window.data1;
+        v[2] = e.window.data2;
+        return true;
+    case SDL_QUIT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+inline SDL_Event DecodeEvent(const RecordedEvent &recorded) {
+    SDL_Event e;
+    std::memset(&e, 0, sizeof(e));
+    e.type = recorded.type;
+    const int32_t *v = recorded.values;
+    switch (recorded.type) {
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+        e.key.state = recorded.type == SDL_KEYDOWN ? SDL_PRESSED : SDL_RELEASED;
+        e.key.keysym.sym = SDL_Keycode(v[0]);
+        e.key.keysym.scancode = SDL_Scancode(v[1]);
+        e.key.keysym.mod = Uint16(v[2]);
+        e.key.repeat = Uint8(v[3]);
+        break;
+    case SDL_MOUSEMOTION:
+        e.motion.x = v[0];
+        e.motion.y = v[1];
+        e.motion.xrel = v[2];
+        e.motion.yrel = v[3];
+        break;
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+        e.button.state = recorded.type == SDL_MOUSEBUTTONDOWN ? SDL_PRESSED : SDL_RELEASED;
+        e.button.button = Uint8(v[0]);
+        e.button.clicks = Uint8(v[1]);
+        e.button.x = v[2];
+        e.button.y = v[3];
+        break;
+    case SDL_MOUSEWHEEL:
+        e.wheel.x = v[0];
+        e.wheel.y = v[1];
+        e.wheel.direction = Uint32(v[2]);
+        break;
+    case SDL_WINDOWEVENT:
+        e.window.event = Uint8(v[0]);
+        e.window.data1 = v[1];
+        e.window.data2 = v[2];
+        break;
+    }
+    return e;
+}
+
+// Appends frames to a recording as they happen
+class InputRecorder {
+  public:
+    bool Open(const std::string &path) {
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "ERROR::INPUT::CANNOT_WRITE " << path << std::endl;
+            return false;
+        }
+        InputFileHeader header = {INPUT_MAGIC, INPUT_VERSION};
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        return true;
+    }
+
+    bool IsOpen() const { return file.is_open(); }
+
+    void WriteFrame(double frameSeconds, const std::vector<SDL_Event> &events) {
+        recorded.clear();
+        RecordedEvent event;
+        for (const SDL_Event &e : events) {
+            if (EncodeEvent(e, event)) {
+                recorded.push_back(event);
+            }
+        }
+        uint32_t count = uint32_t(recorded.size());
+        file.write(reinterpret_cast<const char *>(&frameSeconds), sizeof(frameSeconds));
+        file.write(reinterpret_cast<const char *>(&count), sizeof(count));
+        file.write(reinterpret_cast<const char *>(recorded.data()), std::streamsize(count * sizeof(RecordedEvent)));
+    }
+
+    void Close() { file.close(); }
+
+  private:
+    std::ofstream file;
+    std::vector<RecordedEvent> recorded;
+};
+
+// Plays a recording back frame by frame. The whole file is read up front,
+// so replaying never touches the disk.
+class InputReplay {
+  public:
+    bool Open(const std::string &path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) {
+            std::cerr << "ERROR::INPUT::CANNOT_OPEN " << path << std::endl;
+            return false;
+        }
+        data.resize(size_t(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char *>(data.data()), std::streamsize(data.size()));
+
+        if (!file || data.size() < sizeof(InputFileHeader) || !Validate()) {
+            std::cerr << "ERROR::INPUT::INVALID_FILE " << path << std::endl;
+            data.clear();
+            return false;
+        }
+        position = sizeof(InputFileHeader);
+        frame = 0;
+        open = true;
+        return true;
+    }
+
+    bool IsOpen() const { return open; }
+    size_t FrameCount() const { return frameCount; }
+
+    // Reads the next frame; false once the recording is over
+    bool NextFrame(double &frameSeconds, std::vector<SDL_Event> &events) {
+        events.clear();
+        if (!open || frame >= frameCount) {
+            return false;
+        }
+        uint32_t count;
+        std::memcpy(&frameSeconds, data.data() + position, sizeof(frameSeconds));
+        std::memcpy(&count, data.data() + position + sizeof(frameSeconds), sizeof(count));
+        position += sizeof(frameSeconds) + sizeof(count);
+        for (uint32_t i = 0; i < count; i++) {
+            RecordedEvent event;
+            std::memcpy(&event, data.data() + position, sizeof(event));
+            position += sizeof(event);
+            events.push_back(DecodeEvent(event));
+        }
+        frame++;
+        return true;
+    }
+
+  private:
+    // Checks the header and that every frame record is complete, counting them
+    bool Validate() {
+        InputFileHeader header;
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (header.magic != INPUT_MAGIC || header.version != INPUT_VERSION) {
+            return false;
+        }
+        frameCount = 0;
+        size_t offset = sizeof(header);
+        while (offset < data.size()) {
+            uint32_t count;
+            if (data.size() - offset < sizeof(double) + sizeof(count)) {
+                return false;
+            }
+            std::memcpy(&count, data.data() + offset + sizeof(double), sizeof(count));
+            offset += sizeof(double) + sizeof(count);
+            if ((data.size() - offset) / sizeof(RecordedEvent) < count) {
+                return false;
+            }
+            offset += size_t(count) * sizeof(RecordedEvent);
+            frameCount++;
+        }
+        return true;
+    }
+
+    std::vector<uint8_t> data;
+    size_t position = 0;
+    size_t frame = 0;
+    size_t frameCount = 0;
+    bool open = false;
+};
+
+#endif // INPUT_RECORDING_HPP
@@ -0,0 +1,35 @@
+#ifndef ALIGNED_ALLOCATOR_HPP
+#define ALIGNED_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <new>
+
+// Standard allocator returning storage aligned to Alignment bytes, so SIMD
+// kernels can use aligned loads on std::vector data.
+template <typename T, std::size_t Alignment> struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U> struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &) noexcept {}
+
+    T *allocate(std::size_t n) {
+        return static_cast<T *>(
+            ::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T *p, std::size_t) noexcept {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment> &) const noexcept {
+        return true;
+    }
+};
+
+#endif // ALIGNED_ALLOCATOR_HPP
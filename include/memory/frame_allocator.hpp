@@ -0,0 +1,129 @@
+#ifndef FRAME_ALLOCATOR_HPP
+#define FRAME_ALLOCATOR_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// Scratch memory for data that lives for a frame (draw records, culling
+// results, uniform staging). Allocating is an atomic bump, so any thread may
+// allocate, and nothing is freed individually: each frame allocates from one
+// of FRAMES regions, which is reset when it comes around again. Data from
+// the previous FRAMES - 1 frames therefore stays readable, e.g. by work
+// that overlaps the next frame.
+//
+// A region that runs out falls back to the heap for the rest of the frame
+// and is grown to that frame's total when it is next reused, so a steady
+// workload stops touching the heap after a few frames.
+class FrameAllocator {
+  public:
+    static constexpr size_t FRAMES = 3;
+
+    explicit FrameAllocator(size_t regionCapacity = 256 * 1024) {
+        for (Region &region : regions) {
+            region.Resize(regionCapacity);
+        }
+    }
+
+    FrameAllocator(const FrameAllocator &) = delete;
+    FrameAllocator &operator=(const FrameAllocator &) = delete;
+
+    // Starts a frame, releasing everything allocated FRAMES frames ago. No
+    // allocation of the current frame may be in flight.
+    void BeginFrame() {
+        peakBytes = std::max(peakBytes, BytesUsed());
+        current = (current + 1) % FRAMES;
+        Region &region = regions[current];
+        size_t overflowBytes = region.overflowBytes.load(std::memory_order_relaxed);
+        size_t demand = region.used.load(std::memory_order_relaxed) + overflowBytes;
+        if (overflowBytes > 0) {
+            // room for the frame that overflowed, with some headroom
+            region.Resize(demand + demand / 2);
+        }
+        region.FreeOverflow();
+        region.used.store(0, std::memory_order_relaxed);
+    }
+
+    // alignment must be a power of two, at most ALIGNMENT
+    void *Allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        Region &region = regions[current];
+        size_t offset = region.used.load(std::memory_order_relaxed);
+        while (true) {
+            size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+            if (aligned + size > region.capacity) {
+                break;
+            }
+            if (region.used.compare_exchange_weak(offset, aligned + size, std::memory_order_relaxed)) {
+                return region.data + aligned;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(overflowMutex);
+        void *memory = ::operator new(size, std::align_val_t(ALIGNMENT));
+        region.overflow.push_back(memory);
+        region.overflowBytes.fetch_add(size, std::memory_order_relaxed);
+        return memory;
+    }
+
+    template <typename T> T *Allocate(size_t count) {
+        static_assert(alignof(T) <= ALIGNMENT, "over-aligned type");
+        return static_cast<T *>(Allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // bytes allocated so far this frame, including heap fallbacks
+    size_t BytesUsed() const {
+        const Region &region = regions[current];
+        return region.used.load(std::memory_order_relaxed) + region.overflowBytes.load(std::memory_order_relaxed);
+    }
+
+    // most bytes allocated in a finished frame
+    size_t PeakBytesUsed() const { return peakBytes; }
+
+    // bytes of this frame's allocations that had to come from the heap
+    size_t OverflowBytes() const { return regions[current].overflowBytes.load(std::memory_order_relaxed); }
+
+    size_t RegionCapacity() const { return regions[current].capacity; }
+
+  private:
+    static constexpr size_t ALIGNMENT = 64;
+
+    struct Region {
+        uint8_t *data = nullptr;
+        size_t capacity = 0;
+        std::atomic<size_t> used{0};
+        // heap blocks of allocations that did not fit, guarded by
+        // overflowMutex; their size is atomic so it can be read any time
+        std::vector<void *> overflow;
+        std::atomic<size_t> overflowBytes{0};
+
+        ~Region() {
+            FreeOverflow();
+            ::operator delete(data, std::align_val_t(ALIGNMENT));
+        }
+
+        void Resize(size_t newCapacity) {
+            ::operator delete(data, std::align_val_t(ALIGNMENT));
+            data = static_cast<uint8_t *>(::operator new(newCapacity, std::align_val_t(ALIGNMENT)));
+            capacity = newCapacity;
+        }
+
+        void FreeOverflow() {
+            for (void *memory : overflow) {
+                ::operator delete(memory, std::align_val_t(ALIGNMENT));
+            }
+            overflow.clear();
+            overflowBytes.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    Region regions[FRAMES];
+    size_t current = 0;
+    size_t peakBytes = 0;
+    std::mutex overflowMutex;
+};
+
+#endif // FRAME_ALLOCATOR_HPP
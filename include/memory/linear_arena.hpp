@@ -0,0 +1,91 @@
+#ifndef LINEAR_ARENA_HPP
+#define LINEAR_ARENA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Bump allocator: allocations are a pointer increment and are only freed
+// all at once by Reset(). When a block runs out a new one is chained on;
+// Reset() then merges them into a single block big enough for the whole
+// previous use, so a workload that repeats (a frame) stops allocating
+// after its first run. Not thread-safe; give each thread its own.
+class LinearArena {
+  public:
+    explicit LinearArena(size_t blockSize = 64 * 1024) : blockSize(blockSize) {}
+
+    LinearArena(const LinearArena &) = delete;
+    LinearArena &operator=(const LinearArena &) = delete;
+
+    // alignment must be a power of two
+    void *Allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        uintptr_t address = (uintptr_t(current) + alignment - 1) & ~uintptr_t(alignment - 1);
+        if (!current || address + size > uintptr_t(end)) {
+            AddBlock(size + alignment);
+            address = (uintptr_t(current) + alignment - 1) & ~uintptr_t(alignment - 1);
+        }
+        current = reinterpret_cast<uint8_t *>(address + size);
+        used += size;
+        peak = std::max(peak, used);
+        return reinterpret_cast<void *>(address);
+    }
+
+    template <typename T> T *Allocate(size_t count = 1) {
+        return static_cast<T *>(Allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void Reset() {
+        if (blocks.size() > 1) {
+            size_t total = 0;
+            for (const Block &block : blocks) {
+                total += block.size;
+            }
+            blocks.clear();
+            blockSize = std::max(blockSize, total);
+        }
+        if (blocks.empty()) {
+            current = end = nullptr;
+        } else {
+            current = blocks[0].data.get();
+            end = current + blocks[0].size;
+        }
+        used = 0;
+    }
+
+    // bytes handed out since the last Reset(), without alignment padding
+    size_t BytesUsed() const { return used; }
+    // most bytes handed out between two resets
+    size_t PeakBytesUsed() const { return peak; }
+
+    size_t BytesReserved() const {
+        size_t total = 0;
+        for (const Block &block : blocks) {
+            total += block.size;
+        }
+        return total;
+    }
+
+  private:
+    struct Block {
+        std::unique_ptr<uint8_t[]> data;
+        size_t size;
+    };
+
+    void AddBlock(size_t minimumSize) {
+        size_t size = std::max(blockSize, minimumSize);
+        blocks.push_back({std::make_unique<uint8_t[]>(size), size});
+        current = blocks.back().data.get();
+        end = current + size;
+    }
+
+    size_t blockSize;
+    std::vector<Block> blocks;
+    uint8_t *current = nullptr;
+    uint8_t *end = nullptr;
+    size_t used = 0;
+    size_t peak = 0;
+};
+
+#endif // LINEAR_ARENA_HPP
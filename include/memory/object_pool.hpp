@@ -0,0 +1,81 @@
+#ifndef OBJECT_POOL_HPP
+#define OBJECT_POOL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Fixed-size slots for long-lived objects of one type, carved out of chunks
+// of ChunkSlots slots. Destroyed objects' slots go on a free list and are
+// reused first, so creating and destroying objects never fragments the heap
+// and only touches it when every slot is taken. Objects of a type also end
+// up next to each other in memory. Not thread-safe. Objects still alive when
+// the pool goes away are not destroyed; their owner destroys them first.
+template <typename T, size_t ChunkSlots = 256> class ObjectPool {
+  public:
+    ObjectPool() = default;
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool &operator=(const ObjectPool &) = delete;
+
+    // Makes room for count objects in total, e.g. before a known number of
+    // objects is created
+    void Reserve(size_t count) {
+        while (Capacity() < count) {
+            AddChunk();
+        }
+    }
+
+    template <typename... Args> T *Create(Args &&...args) {
+        if (!freeList) {
+            AddChunk();
+        }
+        Slot *slot = freeList;
+        freeList = slot->next;
+        T *object = new (slot->storage) T(std::forward<Args>(args)...);
+        live++;
+        peak = std::max(peak, live);
+        return object;
+    }
+
+    void Destroy(T *object) {
+        if (!object) {
+            return;
+        }
+        object->~T();
+        Slot *slot = reinterpret_cast<Slot *>(object);
+        slot->next = freeList;
+        freeList = slot;
+        live--;
+    }
+
+    size_t LiveCount() const { return live; }
+    // most objects alive at once
+    size_t PeakCount() const { return peak; }
+    size_t Capacity() const { return chunks.size() * ChunkSlots; }
+
+  private:
+    union Slot {
+        Slot *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    void AddChunk() {
+        chunks.push_back(std::make_unique<Slot[]>(ChunkSlots));
+        Slot *chunk = chunks.back().get();
+        // hand out the chunk front to back
+        for (size_t i = ChunkSlots; i-- > 0;) {
+            chunk[i].next = freeList;
+            freeList = &chunk[i];
+        }
+    }
+
+    std::vector<std::unique_ptr<Slot[]>> chunks;
+    Slot *freeList = nullptr;
+    size_t live = 0;
+    size_t peak = 0;
+};
+
+#endif // OBJECT_POOL_HPP
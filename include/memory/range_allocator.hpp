@@ -0,0 +1,93 @@
+#ifndef RANGE_ALLOCATOR_HPP
+#define RANGE_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hands out ranges of [0, capacity) first-fit and takes them back, merging
+// neighbouring free ranges. It only does the bookkeeping; the storage (e.g.
+// a GL buffer) lives elsewhere, in whatever units the caller counts.
+class RangeAllocator {
+  public:
+    explicit RangeAllocator(uint32_t capacity = 0) { Reset(capacity); }
+
+    // Forgets every allocation
+    void Reset(uint32_t capacity) {
+        this->capacity = capacity;
+        freeRanges.clear();
+        if (capacity > 0) {
+            freeRanges.push_back({0, capacity});
+        }
+    }
+
+    bool Allocate(uint32_t count, uint32_t &offset) {
+        for (size_t i = 0; i < freeRanges.size(); i++) {
+            Range &range = freeRanges[i];
+            if (range.count < count) {
+                continue;
+            }
+            offset = range.offset;
+            range.offset += count;
+            range.count -= count;
+            if (range.count == 0) {
+                freeRanges.erase(freeRanges.begin() + i);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void Free(uint32_t offset, uint32_t count) {
+        if (count == 0) {
+            return;
+        }
+        // free ranges are kept sorted by offset
+        size_t i = 0;
+        while (i < freeRanges.size() && freeRanges[i].offset < offset) {
+            i++;
+        }
+        freeRanges.insert(freeRanges.begin() + i, {offset, count});
+
+        if (i + 1 < freeRanges.size() && offset + count == freeRanges[i + 1].offset) {
+            freeRanges[i].count += freeRanges[i + 1].count;
+            freeRanges.erase(freeRanges.begin() + i + 1);
+        }
+        if (i > 0 && freeRanges[i - 1].offset + freeRanges[i - 1].count == offset) {
+            freeRanges[i - 1].count += freeRanges[i].count;
+            freeRanges.erase(freeRanges.begin() + i);
+        }
+    }
+
+    // Adds [capacity, newCapacity) as free space
+    void Grow(uint32_t newCapacity) {
+        if (newCapacity <= capacity) {
+            return;
+        }
+        uint32_t added = newCapacity - capacity;
+        uint32_t oldCapacity = capacity;
+        capacity = newCapacity;
+        Free(oldCapacity, added);
+    }
+
+    uint32_t Capacity() const { return capacity; }
+
+    // One past the last allocated unit; everything beyond is free
+    uint32_t End() const {
+        if (!freeRanges.empty() && freeRanges.back().offset + freeRanges.back().count == capacity) {
+            return freeRanges.back().offset;
+        }
+        return capacity;
+    }
+
+  private:
+    struct Range {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    uint32_t capacity = 0;
+    std::vector<Range> freeRanges;
+};
+
+#endif // RANGE_ALLOCATOR_HPP
@@ -0,0 +1,129 @@
+#ifndef MAPPED_MESH_HPP
+#define MAPPED_MESH_HPP
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+
+#include "mesh_format.hpp"
+
+// Read-only memory mapping of a .mesh file. Nothing is parsed or copied:
+// the vertex and index blocks are handed to GL straight from the mapping,
+// so loading costs one page-in of the file.
+class MappedMesh {
+  public:
+    MappedMesh() = default;
+    ~MappedMesh() { Close(); }
+
+    MappedMesh(const MappedMesh &) = delete;
+    MappedMesh &operator=(const MappedMesh &) = delete;
+
+    MappedMesh(MappedMesh &&other) noexcept { *this = std::move(other); }
+    MappedMesh &operator=(MappedMesh &&other) noexcept {
+        if (this != &other) {
+            Close();
+            data = other.data;
+            size = other.size;
+            other.data = nullptr;
+            other.size = 0;
+        }
+        return *this;
+    }
+
+    bool Open(const std::string &path) {
+        Close();
+
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "ERROR::MESH::CANNOT_OPEN " << path << std::endl;
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(MeshFileHeader)) {
+            std::cerr << "ERROR::MESH::TRUNCATED " << path << std::endl;
+            close(fd);
+            return false;
+        }
+
+        void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            std::cerr << "ERROR::MESH::CANNOT_MAP " << path << std::endl;
+            return false;
+        }
+        // The whole file is about to be read front to back by the upload.
+        // Advice values are not flags, so each needs its own call.
+        madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+        madvise(mapping, info.st_size, MADV_WILLNEED);
+
+        data = static_cast<const uint8_t *>(mapping);
+        size = static_cast<size_t>(info.st_size);
+        if (!Validate()) {
+            std::cerr << "ERROR::MESH::INVALID_FILE " << path << std::endl;
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close() {
+        if (data) {
+            munmap(const_cast<uint8_t *>(data), size);
+            data = nullptr;
+            size = 0;
+        }
+    }
+
+    bool IsOpen() const { return data != nullptr; }
+
+    // Faults every page of the file in, so that whoever reads the mapping
+    // next (e.g. the GL upload) does not stall on disk
+    void Prefetch() const {
+        const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+        uint8_t sum = 0;
+        for (size_t offset = 0; offset < size; offset += pageSize) {
+            sum ^= static_cast<const volatile uint8_t *>(data)[offset];
+        }
+        (void)sum;
+    }
+
+    const MeshFileHeader &Header() const { return *reinterpret_cast<const MeshFileHeader *>(data); }
+    const void *Vertices() const { return data + Header().vertexOffset; }
+    const void *Indices() const { return data + Header().indexOffset; }
+
+  private:
+    bool Validate() const {
+        const MeshFileHeader &header = Header();
+        if (header.magic != MESH_MAGIC || header.version != MESH_VERSION) {
+            return false;
+        }
+        if (header.vertexStride == 0 || header.vertexStride != MeshVertexStride(header.vertexLayout) ||
+            header.vertexBytes != uint64_t(header.vertexStride) * header.vertexCount) {
+            return false;
+        }
+        if (header.indexSize != sizeof(uint32_t) ||
+            header.indexBytes != uint64_t(header.indexSize) * header.indexCount) {
+            return false;
+        }
+        if (header.vertexOffset % MESH_BLOCK_ALIGNMENT || header.indexOffset % MESH_BLOCK_ALIGNMENT) {
+            return false;
+        }
+        return FitsInFile(header.vertexOffset, header.vertexBytes) && FitsInFile(header.indexOffset, header.indexBytes);
+    }
+
+    // written so that a crafted offset cannot wrap around
+    bool FitsInFile(uint64_t offset, uint64_t bytes) const { return offset <= size && bytes <= size - offset; }
+
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+};
+
+#endif // MAPPED_MESH_HPP
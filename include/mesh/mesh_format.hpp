@@ -0,0 +1,51 @@
+#ifndef MESH_FORMAT_HPP
+#define MESH_FORMAT_HPP
+
+#include <cstdint>
+
+#include "vertex_format.hpp"
+
+// Binary mesh file (.mesh), written by tools/mesh_converter and loaded by
+// MappedMesh. The file is laid out so it can be mapped and handed to GL as
+// is: a fixed header, then the vertex block and the index block, each
+// starting at a MESH_BLOCK_ALIGNMENT boundary. All values are little-endian.
+//
+//   [MeshFileHeader][pad][vertices][pad][indices]
+
+constexpr uint32_t MESH_MAGIC = 0x4853454d; // "MESH"
+constexpr uint32_t MESH_VERSION = 3;
+constexpr uint32_t MESH_BLOCK_ALIGNMENT = 64;
+
+struct MeshFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    MeshVertexLayout vertexLayout;
+    uint32_t vertexStride; // bytes per vertex
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexSize;    // bytes per index, always 4
+    uint32_t reserved0;
+    uint64_t vertexOffset; // from the start of the file
+    uint64_t vertexBytes;
+    uint64_t indexOffset;
+    uint64_t indexBytes;
+    float boundsMin[3];
+    float boundsMax[3];
+    // model space position = positionOffset + positionScale * stored position
+    float positionOffset[3];
+    float positionScale[3];
+    uint32_t reserved1[4];
+};
+
+static_assert(sizeof(MeshFileHeader) == 128, "MeshFileHeader is part of the file format");
+
+inline uint64_t AlignMeshOffset(uint64_t offset) {
+    return (offset + MESH_BLOCK_ALIGNMENT - 1) / MESH_BLOCK_ALIGNMENT * MESH_BLOCK_ALIGNMENT;
+}
+
+// 0 for unknown layouts
+inline uint32_t MeshVertexStride(MeshVertexLayout layout) {
+    return GetVertexFormat(layout).stride;
+}
+
+#endif // MESH_FORMAT_HPP
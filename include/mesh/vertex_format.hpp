@@ -0,0 +1,218 @@
+#ifndef VERTEX_FORMAT_HPP
+#define VERTEX_FORMAT_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Declarative description of the vertex layouts meshes can be stored in.
+// The converter writes vertices by it and the renderer builds its vertex
+// attribute bindings from it, so a layout is defined in exactly one place.
+// Kept free of GL so offline tools can use it.
+
+// Attribute locations shared by every vertex shader. Location 2 is the
+// per-instance index of instanced draws.
+constexpr uint32_t VERTEX_POSITION_LOCATION = 0;
+constexpr uint32_t VERTEX_COLOR_LOCATION = 1;
+constexpr uint32_t VERTEX_NORMAL_LOCATION = 3;
+
+enum class VertexAttributeType : uint32_t {
+    Float32,
+    Half,
+    Snorm16,
+    Unorm8,
+    // one packed 32-bit signed 10:10:10:2 value, read with 4 components
+    Snorm10_10_10_2,
+};
+
+struct VertexAttribute {
+    uint32_t location;
+    uint32_t components;
+    VertexAttributeType type;
+    bool normalized;
+    uint32_t offset; // bytes from the start of the vertex
+};
+
+struct VertexFormat {
+    static constexpr uint32_t MAX_ATTRIBUTES = 4;
+
+    uint32_t stride = 0; // 0 for unknown layouts
+    uint32_t attributeCount = 0;
+    VertexAttribute attributes[MAX_ATTRIBUTES] = {};
+};
+
+// How the vertex block of a mesh is laid out. Quantized positions are
+// relative to the mesh and turned back into model space by a per-mesh
+// transform, position = offset + scale * stored (see MeshFileHeader).
+enum class MeshVertexLayout : uint32_t {
+    // vec3 position, vec3 color; 24 bytes
+    PositionColor = 0,
+    // snorm16 position scaled to the mesh bounds, 10:10:10:2 normal,
+    // unorm8 color; 16 bytes
+    Snorm16PositionNormalColor = 1,
+    // half position relative to the bounds center, 10:10:10:2 normal,
+    // unorm8 color; 16 bytes. Less precise than snorm16 far from the
+    // center, but needs no scale.
+    HalfPositionNormalColor = 2,
+};
+
+inline const VertexFormat &GetVertexFormat(MeshVertexLayout layout) {
+    static const VertexFormat positionColor = {
+        24, 2, {
+            {VERTEX_POSITION_LOCATION, 3, VertexAttributeType::Float32, false, 0},
+            {VERTEX_COLOR_LOCATION, 3, VertexAttributeType::Float32, false, 12},
+        }};
+    // Attributes start on 4-byte boundaries, which some GPUs fetch much
+    // faster; the padding after the 6-byte position and 3-byte color is free
+    static const VertexFormat snorm16PositionNormalColor = {
+        16, 3, {
+            {VERTEX_POSITION_LOCATION, 3, VertexAttributeType::Snorm16, true, 0},
+            {VERTEX_NORMAL_LOCATION, 4, VertexAttributeType::Snorm10_10_10_2, true, 8},
+            {VERTEX_COLOR_LOCATION, 3, VertexAttributeType::Unorm8, true, 12},
+        }};
+    static const VertexFormat halfPositionNormalColor = {
+        16, 3, {
+            {VERTEX_POSITION_LOCATION, 3, VertexAttributeType::Half, false, 0},
+            {VERTEX_NORMAL_LOCATION, 4, VertexAttributeType::Snorm10_10_10_2, true, 8},
+            {VERTEX_COLOR_LOCATION, 3, VertexAttributeType::Unorm8, true, 12},
+        }};
+    static const VertexFormat unknown = {};
+
+    switch (layout) {
+    case MeshVertexLayout::PositionColor:
+        return positionColor;
+    case MeshVertexLayout::Snorm16PositionNormalColor:
+        return snorm16PositionNormalColor;
+    case MeshVertexLayout::HalfPositionNormalColor:
+        return halfPositionNormalColor;
+    }
+    return unknown;
+}
+
+// Encoders for the quantized attribute types
+
+inline int16_t PackSnorm16(float value) {
+    return int16_t(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+inline uint8_t PackUnorm8(float value) {
+    return uint8_t(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+// x, y, z in the low 30 bits as signed 10-bit values, w = 0
+inline uint32_t PackSnorm10_10_10_2(float x, float y, float z) {
+    auto pack = [](float value) {
+        return uint32_t(std::lround(std::clamp(value, -1.0f, 1.0f) * 511.0f)) & 0x3ffu;
+    };
+    return pack(x) | (pack(y) << 10) | (pack(z) << 20);
+}
+
+// IEEE 754 binary16, rounding to nearest even
+inline uint16_t PackHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t biased = (bits >> 23) & 0xffu;
+    uint32_t mantissa = bits & 0x7fffffu;
+
+    if (biased == 0xff) {
+        return uint16_t(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+    }
+    int32_t exponent = int32_t(biased) - 127 + 15;
+    if (exponent >= 31) {
+        return uint16_t(sign | 0x7c00u);
+    }
+
+    uint32_t shift = 13;
+    uint32_t half;
+    if (exponent <= 0) {
+        // subnormal in half precision
+        if (exponent < -10) {
+            return uint16_t(sign);
+        }
+        mantissa |= 0x800000u;
+        shift = uint32_t(14 - exponent);
+        half = mantissa >> shift;
+    } else {
+        half = (uint32_t(exponent) << 10) | (mantissa >> shift);
+    }
+
+    // a carry out of the mantissa correctly bumps the exponent
+    uint32_t rest = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half & 1))) {
+        half++;
+    }
+    return uint16_t(sign | half);
+}
+
+// Picks the dequantization (model position = offset + scale * stored) for
+// a mesh of this layout whose positions span center +- halfExtent
+inline void ChooseDequantization(MeshVertexLayout layout, const float center[3], const float halfExtent[3],
+                                 float offset[3], float scale[3]) {
+    for (int axis = 0; axis < 3; axis++) {
+        switch (layout) {
+        case MeshVertexLayout::PositionColor:
+            offset[axis] = 0.0f;
+            scale[axis] = 1.0f;
+            break;
+        case MeshVertexLayout::Snorm16PositionNormalColor:
+            // [-1, 1] spans the extent
+            offset[axis] = center[axis];
+            scale[axis] = halfExtent[axis];
+            break;
+        case MeshVertexLayout::HalfPositionNormalColor:
+            offset[axis] = center[axis];
+            scale[axis] = 1.0f;
+            break;
+        }
+    }
+}
+
+// Encodes one vertex into the format. position is in stored space, i.e.
+// already (model position - offset) / scale; colors are in [0, 1].
+inline void WriteVertex(const VertexFormat &format, uint8_t *vertex, const float position[3], const float normal[3],
+                        const float color[3]) {
+    for (uint32_t a = 0; a < format.attributeCount; a++) {
+        const VertexAttribute &attribute = format.attributes[a];
+        uint8_t *out = vertex + attribute.offset;
+
+        const float *values = color;
+        if (attribute.location == VERTEX_POSITION_LOCATION) {
+            values = position;
+        } else if (attribute.location == VERTEX_NORMAL_LOCATION) {
+            values = normal;
+        }
+
+        switch (attribute.type) {
+        case VertexAttributeType::Float32:
+            std::memcpy(out, values, 3 * sizeof(float));
+            break;
+        case VertexAttributeType::Half:
+            for (int c = 0; c < 3; c++) {
+                uint16_t half = PackHalf(values[c]);
+                std::memcpy(out + c * sizeof(half), &half, sizeof(half));
+            }
+            break;
+        case VertexAttributeType::Snorm16:
+            for (int c = 0; c < 3; c++) {
+                int16_t snorm = PackSnorm16(values[c]);
+                std::memcpy(out + c * sizeof(snorm), &snorm, sizeof(snorm));
+            }
+            break;
+        case VertexAttributeType::Unorm8:
+            for (int c = 0; c < 3; c++) {
+                out[c] = PackUnorm8(values[c]);
+            }
+            break;
+        case VertexAttributeType::Snorm10_10_10_2: {
+            uint32_t packed = PackSnorm10_10_10_2(values[0], values[1], values[2]);
+            std::memcpy(out, &packed, sizeof(packed));
+            break;
+        }
+        }
+    }
+}
+
+#endif // VERTEX_FORMAT_HPP
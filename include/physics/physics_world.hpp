@@ -0,0 +1,276 @@
+#ifndef PHYSICS_WORLD_HPP
+#define PHYSICS_WORLD_HPP
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "btBulletDynamicsCommon.h"
+#include "concurrency/triple_buffer.hpp"
+#include "memory/object_pool.hpp"
+
+// Body transforms published by the physics thread. Matrices are stored the
+// way btTransform::getOpenGLMatrix writes them (column-major, 16 scalars per
+// body), in the order the bodies were added. modifiedTicks[i] is the tick at
+// which body i last moved, so consumers can rewrite only what changed since
+// the tick they last saw.
+struct PhysicsSnapshot {
+    uint64_t tick = 0;
+    std::vector<btScalar> matrices;
+    std::vector<uint64_t> modifiedTicks;
+};
+
+// Transforms of the dynamic bodies as last reported by Bullet. Owned by the
+// physics thread.
+struct BodyTransformTable {
+    uint64_t tick = 1;
+    std::vector<btScalar> matrices;
+    std::vector<uint64_t> modifiedTicks;
+};
+
+// Motion state of a dynamic body. btDiscreteDynamicsWorld only calls
+// setWorldTransform for active bodies after a step, so sleeping bodies cost
+// nothing; moved ones are written straight in OpenGL layout and stamped
+// with the current tick.
+class BodyMotionState : public btMotionState {
+  public:
+    BodyMotionState(const btTransform &startTransform, BodyTransformTable &table, size_t index)
+        : transform(startTransform), table(table), index(index) {
+        Record();
+    }
+
+    void getWorldTransform(btTransform &worldTransform) const override {
+        worldTransform = transform;
+    }
+
+    void setWorldTransform(const btTransform &worldTransform) override {
+        transform = worldTransform;
+        Record();
+    }
+
+  private:
+    void Record() {
+        transform.getOpenGLMatrix(&table.matrices[16 * index]);
+        table.modifiedTicks[index] = table.tick;
+    }
+
+    btTransform transform;
+    BodyTransformTable &table;
+    size_t index;
+};
+
+// Bullet dynamics world stepped at a fixed rate on a dedicated thread.
+// Bodies are added before Start(); afterwards only the physics thread
+// touches the world, and the render thread reads transforms through a
+// triple buffer, so neither side ever blocks on the other.
+class PhysicsWorld {
+  public:
+    PhysicsWorld() {
+        collisionConfiguration = std::make_unique<btDefaultCollisionConfiguration>();
+        dispatcher = std::make_unique<btCollisionDispatcher>(collisionConfiguration.get());
+        broadphase = std::make_unique<btDbvtBroadphase>();
+        solver = std::make_unique<btSequentialImpulseConstraintSolver>();
+        world = std::make_unique<btDiscreteDynamicsWorld>(
+            dispatcher.get(), broadphase.get(), solver.get(), collisionConfiguration.get());
+        world->setGravity(btVector3(0.0f, -9.81f, 0.0f));
+    }
+
+    ~PhysicsWorld() {
+        Stop();
+        for (btRigidBody *body : rigidBodies) {
+            world->removeRigidBody(body);
+            bodyPool.Destroy(body);
+        }
+        for (BodyMotionState *motionState : bodyMotionStates) {
+            bodyMotionStatePool.Destroy(motionState);
+        }
+        for (btDefaultMotionState *motionState : staticMotionStates) {
+            staticMotionStatePool.Destroy(motionState);
+        }
+    }
+
+    PhysicsWorld(const PhysicsWorld &) = delete;
+    PhysicsWorld &operator=(const PhysicsWorld &) = delete;
+
+    // infinite static ground plane facing up at the given height
+    void AddGroundPlane(float height) {
+        btCollisionShape *shape = AddShape(std::make_unique<btStaticPlaneShape>(btVector3(0.0f, 1.0f, 0.0f), height));
+        staticMotionStates.push_back(staticMotionStatePool.Create());
+        AddRigidBody(shape, 0.0f, staticMotionStates.back());
+    }
+
+    // Adds a dynamic box and returns its index in the published snapshots.
+    // Transform must be a rigid transform (no scale).
+    int AddBox(const glm::vec3 &halfExtents, float mass, const glm::mat4 &transform) {
+        btCollisionShape *shape = FindBoxShape(halfExtents);
+        if (!shape) {
+            shape = AddShape(std::make_unique<btBoxShape>(btVector3(halfExtents.x, halfExtents.y, halfExtents.z)));
+            boxShapes.push_back({halfExtents, shape});
+        }
+
+        btTransform startTransform;
+        startTransform.setFromOpenGLMatrix(glm::value_ptr(transform));
+
+        size_t index = dynamicBodies.size();
+        transforms.matrices.resize(16 * (index + 1));
+        transforms.modifiedTicks.resize(index + 1);
+        bodyMotionStates.push_back(bodyMotionStatePool.Create(startTransform, transforms, index));
+
+        dynamicBodies.push_back(AddRigidBody(shape, mass, bodyMotionStates.back()));
+        return static_cast<int>(index);
+    }
+
+    size_t BodyCount() const { return dynamicBodies.size(); }
+    // most rigid bodies alive at once, static ones included
+    size_t PeakRigidBodyCount() const { return bodyPool.PeakCount(); }
+
+    // Starts stepping on the physics thread at the given rate
+    void Start(double ticksPerSecond) {
+        if (running) {
+            return;
+        }
+        PrepareSnapshots();
+        tickDelta = 1.0 / ticksPerSecond;
+        running = true;
+        worker = std::thread(&PhysicsWorld::ThreadMain, this);
+    }
+
+    void Stop() {
+        running = false;
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    // Steps and publishes on the calling thread. Only valid while the physics
+    // thread is not running; used where runs must be reproducible.
+    void Step(float seconds) {
+        if (running) {
+            return;
+        }
+        PrepareSnapshots();
+        ++transforms.tick;
+        world->stepSimulation(seconds, 0);
+        Publish();
+    }
+
+    // Render side: the most recently published transforms. Never blocks.
+    const PhysicsSnapshot &LatestSnapshot() {
+        snapshots.Acquire();
+        return snapshots.ReadBuffer();
+    }
+
+  private:
+    void ThreadMain() {
+        using Clock = std::chrono::steady_clock;
+        const auto tickDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(tickDelta));
+
+        auto nextTick = Clock::now();
+        while (running) {
+            ++transforms.tick;
+            world->stepSimulation(static_cast<btScalar>(tickDelta), 0);
+            Publish();
+
+            // If a step overran by more than a few ticks, resynchronize with
+            // the clock instead of trying to catch up
+            nextTick += tickDuration;
+            auto now = Clock::now();
+            if (nextTick + 4 * tickDuration < now) {
+                nextTick = now;
+            }
+            std::this_thread::sleep_until(nextTick);
+        }
+    }
+
+    void PrepareSnapshots() {
+        if (snapshotsReady) {
+            return;
+        }
+        snapshots.ForEach([&](PhysicsSnapshot &snapshot) {
+            snapshot.matrices.assign(dynamicBodies.size() * 16, 0.0f);
+            snapshot.modifiedTicks.assign(dynamicBodies.size(), 0);
+        });
+        snapshotsReady = true;
+    }
+
+    // The back buffer may be several ticks old (the reader hands back
+    // whichever buffer it held), so bring over every body that moved since
+    // the tick it was last written at
+    void Publish() {
+        PhysicsSnapshot &snapshot = snapshots.WriteBuffer();
+        for (size_t i = 0; i < dynamicBodies.size(); ++i) {
+            if (transforms.modifiedTicks[i] > snapshot.tick) {
+                std::copy_n(&transforms.matrices[16 * i], 16, &snapshot.matrices[16 * i]);
+                snapshot.modifiedTicks[i] = transforms.modifiedTicks[i];
+            }
+        }
+        snapshot.tick = transforms.tick;
+        snapshots.Publish();
+    }
+
+    btCollisionShape *AddShape(std::unique_ptr<btCollisionShape> shape) {
+        shapes.push_back(std::move(shape));
+        return shapes.back().get();
+    }
+
+    btCollisionShape *FindBoxShape(const glm::vec3 &halfExtents) const {
+        for (const auto &box : boxShapes) {
+            if (box.halfExtents == halfExtents) {
+                return box.shape;
+            }
+        }
+        return nullptr;
+    }
+
+    btRigidBody *AddRigidBody(btCollisionShape *shape, float mass, btMotionState *motionState) {
+        btVector3 localInertia(0.0f, 0.0f, 0.0f);
+        if (mass != 0.0f) {
+            shape->calculateLocalInertia(mass, localInertia);
+        }
+
+        btRigidBody::btRigidBodyConstructionInfo info(mass, motionState, shape, localInertia);
+        rigidBodies.push_back(bodyPool.Create(info));
+        world->addRigidBody(rigidBodies.back());
+        return rigidBodies.back();
+    }
+
+    struct BoxShape {
+        glm::vec3 halfExtents;
+        btCollisionShape *shape;
+    };
+
+    // Bullet objects; declaration order matters for destruction
+    std::unique_ptr<btDefaultCollisionConfiguration> collisionConfiguration;
+    std::unique_ptr<btCollisionDispatcher> dispatcher;
+    std::unique_ptr<btBroadphaseInterface> broadphase;
+    std::unique_ptr<btSequentialImpulseConstraintSolver> solver;
+    std::unique_ptr<btDiscreteDynamicsWorld> world;
+    std::vector<std::unique_ptr<btCollisionShape>> shapes;
+    std::vector<BoxShape> boxShapes;
+    // Bodies and their motion states live in pools, next to each other in
+    // memory, instead of one heap block each
+    ObjectPool<btRigidBody> bodyPool;
+    ObjectPool<BodyMotionState> bodyMotionStatePool;
+    ObjectPool<btDefaultMotionState, 4> staticMotionStatePool;
+    std::vector<btRigidBody *> rigidBodies;
+    std::vector<BodyMotionState *> bodyMotionStates;
+    std::vector<btDefaultMotionState *> staticMotionStates;
+    std::vector<btRigidBody *> dynamicBodies;
+
+    BodyTransformTable transforms;
+    TripleBuffer<PhysicsSnapshot> snapshots;
+    bool snapshotsReady = false;
+
+    std::thread worker;
+    std::atomic<bool> running{false};
+    double tickDelta = 1.0 / 60.0;
+};
+
+#endif // PHYSICS_WORLD_HPP
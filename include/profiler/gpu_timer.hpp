@@ -0,0 +1,108 @@
+#ifndef GPU_TIMER_HPP
+#define GPU_TIMER_HPP
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "profiler.hpp"
+
+// GL_TIME_ELAPSED queries around render passes. Queries rotate through
+// FRAME_LATENCY frame slots, so results are read back FRAME_LATENCY - 1
+// frames after they were recorded, and only if already available; timing
+// never stalls the pipeline, and late results are dropped instead of
+// waited for.
+// Time-elapsed queries cannot nest, so GPU zones must not overlap.
+class GpuTimer {
+  public:
+    static constexpr int FRAME_LATENCY = 4;
+
+    void BeginZone(const char *name) {
+        if (!Profiler::Get().IsEnabled() || activeZone) {
+            return;
+        }
+        Frame &frame = frames[frameIndex];
+        if (frame.used == frame.zones.size()) {
+            Zone zone;
+            glGenQueries(1, &zone.query);
+            frame.zones.push_back(zone);
+        }
+        Zone &zone = frame.zones[frame.used++];
+        zone.name = name;
+        zone.cpuStartNs = Profiler::NowNs();
+        glBeginQuery(GL_TIME_ELAPSED, zone.query);
+        activeZone = true;
+    }
+
+    void EndZone() {
+        if (!activeZone) {
+            return;
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+        activeZone = false;
+    }
+
+    // Advances to the next frame slot and harvests the results it holds,
+    // recorded FRAME_LATENCY - 1 frames before the frame just ended.
+    void EndFrame() {
+        frameIndex = (frameIndex + 1) % FRAME_LATENCY;
+        Frame &frame = frames[frameIndex];
+        for (size_t i = 0; i < frame.used; ++i) {
+            Zone &zone = frame.zones[i];
+            GLint available = 0;
+            glGetQueryObjectiv(zone.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                continue;
+            }
+            GLuint64 elapsedNs = 0;
+            glGetQueryObjectui64v(zone.query, GL_QUERY_RESULT, &elapsedNs);
+            // The GPU start time is unknown; anchor the zone at its CPU submission
+            Profiler::Get().RecordGpuZone(zone.name, zone.cpuStartNs, elapsedNs);
+        }
+        frame.used = 0;
+    }
+
+    void Destroy() {
+        for (Frame &frame : frames) {
+            for (Zone &zone : frame.zones) {
+                glDeleteQueries(1, &zone.query);
+            }
+            frame.zones.clear();
+            frame.used = 0;
+        }
+    }
+
+  private:
+    struct Zone {
+        const char *name = nullptr;
+        unsigned int query = 0;
+        uint64_t cpuStartNs = 0;
+    };
+
+    // queries are pooled per frame slot and reused once harvested
+    struct Frame {
+        std::vector<Zone> zones;
+        size_t used = 0;
+    };
+
+    Frame frames[FRAME_LATENCY];
+    int frameIndex = 0;
+    bool activeZone = false;
+};
+
+// Scoped GPU zone; see GpuTimer for the nesting restriction
+class ScopedGpuZone {
+  public:
+    ScopedGpuZone(GpuTimer &timer, const char *name) : timer(timer) {
+        timer.BeginZone(name);
+    }
+    ~ScopedGpuZone() { timer.EndZone(); }
+
+    ScopedGpuZone(const ScopedGpuZone &) = delete;
+    ScopedGpuZone &operator=(const ScopedGpuZone &) = delete;
+
+  private:
+    GpuTimer &timer;
+};
+
+#endif // GPU_TIMER_HPP
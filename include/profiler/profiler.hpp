@@ -0,0 +1,261 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A completed CPU or GPU zone. Names must be string literals (or otherwise
+// outlive the profiler): only the pointer is recorded.
+struct ZoneEvent {
+    const char *name;
+    uint64_t startNs;
+    uint64_t endNs;
+    uint32_t threadId;
+    uint32_t depth;
+};
+
+// Single-producer/single-consumer ring of zone events. The owning thread
+// pushes, the thread calling Profiler::EndFrame() pops; neither ever locks.
+// When the consumer falls behind, new events are dropped and counted.
+class ZoneRing {
+  public:
+    static constexpr uint32_t CAPACITY = 1 << 14; // must be a power of two
+
+    explicit ZoneRing(uint32_t threadId) : threadId(threadId) {}
+
+    void Push(const ZoneEvent &event) {
+        uint32_t head = this->head.load(std::memory_order_relaxed);
+        uint32_t tail = this->tail.load(std::memory_order_acquire);
+        if (head - tail == CAPACITY) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        events[head & (CAPACITY - 1)] = event;
+        this->head.store(head + 1, std::memory_order_release);
+    }
+
+    // moves every available event into out
+    void Drain(std::vector<ZoneEvent> &out) {
+        uint32_t tail = this->tail.load(std::memory_order_relaxed);
+        uint32_t head = this->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            out.push_back(events[tail & (CAPACITY - 1)]);
+        }
+        this->tail.store(tail, std::memory_order_release);
+    }
+
+    uint32_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+
+    const uint32_t threadId;
+    std::string threadName;
+    uint32_t depth = 0; // only touched by the owning thread
+
+  private:
+    ZoneEvent events[CAPACITY];
+    alignas(64) std::atomic<uint32_t> head{0};
+    alignas(64) std::atomic<uint32_t> tail{0};
+    std::atomic<uint32_t> dropped{0};
+};
+
+// Collects CPU zones from every thread (and GPU zones from GpuTimer) and
+// exports them as a Chrome trace (chrome://tracing, Perfetto) or a CSV summary.
+class Profiler {
+  public:
+    // GPU zones are reported on their own track
+    static constexpr uint32_t GPU_THREAD_ID = 0xffffffffu;
+
+    static Profiler &Get() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    static uint64_t NowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    void SetEnabled(bool value) { enabled.store(value, std::memory_order_relaxed); }
+    bool IsEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // ring of the calling thread, registered on first use
+    ZoneRing &ThreadRing() {
+        thread_local ZoneRing *ring = nullptr;
+        if (!ring) {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            rings.push_back(std::make_unique<ZoneRing>(static_cast<uint32_t>(rings.size())));
+            ring = rings.back().get();
+        }
+        return *ring;
+    }
+
+    void SetThreadName(const std::string &name) {
+        ZoneRing &ring = ThreadRing();
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        ring.threadName = name;
+    }
+
+    // called by GpuTimer once a query result is available
+    void RecordGpuZone(const char *name, uint64_t startNs, uint64_t durationNs) {
+        if (events.size() < MAX_EVENTS) {
+            events.push_back({name, startNs, startNs + durationNs, GPU_THREAD_ID, 0});
+        }
+    }
+
+    // Collects the zones recorded by all threads since the last call.
+    // Call once per frame from the main thread.
+    void EndFrame() {
+        if (!IsEnabled()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (auto &ring : rings) {
+            ring->Drain(events);
+        }
+        if (events.size() > MAX_EVENTS) {
+            events.resize(MAX_EVENTS);
+        }
+    }
+
+    bool WriteChromeTrace(const std::string &path) const {
+        std::ofstream out(path);
+        if (!out) {
+            return false;
+        }
+
+        uint64_t origin = UINT64_MAX;
+        for (const ZoneEvent &e : events) {
+            origin = std::min(origin, e.startNs);
+        }
+
+        out << "{\"traceEvents\":[\n";
+        out << std::fixed << std::setprecision(3);
+        bool first = true;
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            for (const auto &ring : rings) {
+                std::string name = ring->threadName.empty()
+                    ? "Thread " + std::to_string(ring->threadId) : ring->threadName;
+                WriteThreadName(out, first, ring->threadId, name);
+            }
+        }
+        WriteThreadName(out, first, GPU_THREAD_ID, "GPU");
+
+        for (const ZoneEvent &e : events) {
+            out << (first ? "" : ",\n");
+            first = false;
+            out << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+                << e.threadId << ",\"ts\":" << (e.startNs - origin) / 1000.0
+                << ",\"dur\":" << (e.endNs - e.startNs) / 1000.0 << "}";
+        }
+        out << "\n]}\n";
+        return bool(out);
+    }
+
+    // One row per (thread, zone): count, total, mean, min and max in milliseconds
+    bool WriteCsvSummary(const std::string &path) const {
+        std::ofstream out(path);
+        if (!out) {
+            return false;
+        }
+
+        struct Summary {
+            uint64_t count = 0;
+            double total = 0.0;
+            double min = 1e300;
+            double max = 0.0;
+        };
+        std::map<std::pair<uint32_t, std::string>, Summary> summaries;
+        for (const ZoneEvent &e : events) {
+            double ms = (e.endNs - e.startNs) / 1e6;
+            Summary &s = summaries[{e.threadId, e.name}];
+            s.count++;
+            s.total += ms;
+            s.min = std::min(s.min, ms);
+            s.max = std::max(s.max, ms);
+        }
+
+        out << "thread,zone,count,total_ms,mean_ms,min_ms,max_ms\n";
+        out << std::fixed << std::setprecision(4);
+        for (const auto &[key, s] : summaries) {
+            out << (key.first == GPU_THREAD_ID ? std::string("GPU") : std::to_string(key.first))
+                << "," << key.second << "," << s.count << "," << s.total << ","
+                << s.total / s.count << "," << s.min << "," << s.max << "\n";
+        }
+        return bool(out);
+    }
+
+    uint64_t DroppedEvents() const {
+        uint64_t dropped = 0;
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (const auto &ring : rings) {
+            dropped += ring->Dropped();
+        }
+        return dropped;
+    }
+
+  private:
+    // upper bound on retained events, so long sessions cannot grow unbounded
+    static constexpr size_t MAX_EVENTS = 4 * 1024 * 1024;
+
+    Profiler() = default;
+
+    static void WriteThreadName(std::ofstream &out, bool &first, uint32_t tid,
+                                const std::string &name) {
+        out << (first ? "" : ",\n");
+        first = false;
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << tid
+            << ",\"args\":{\"name\":\"" << name << "\"}}";
+    }
+
+    std::atomic<bool> enabled{false};
+    mutable std::mutex ringsMutex;
+    std::vector<std::unique_ptr<ZoneRing>> rings;
+    std::vector<ZoneEvent> events;
+};
+
+// Records the enclosing scope as a CPU zone of the calling thread
+class ScopedZone {
+  public:
+    explicit ScopedZone(const char *name) : name(name) {
+        if (!Profiler::Get().IsEnabled()) {
+            return;
+        }
+        ring = &Profiler::Get().ThreadRing();
+        depth = ring->depth++;
+        startNs = Profiler::NowNs();
+    }
+
+    ~ScopedZone() {
+        if (!ring) {
+            return;
+        }
+        ring->depth--;
+        ring->Push({name, startNs, Profiler::NowNs(), ring->threadId, depth});
+    }
+
+    ScopedZone(const ScopedZone &) = delete;
+    ScopedZone &operator=(const ScopedZone &) = delete;
+
+  private:
+    const char *name;
+    ZoneRing *ring = nullptr;
+    uint64_t startNs = 0;
+    uint32_t depth = 0;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ScopedZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+
+#endif // PROFILER_HPP
@@ -0,0 +1,45 @@
+#ifndef CAMERA_UNIFORM_BUFFER_HPP
+#define CAMERA_UNIFORM_BUFFER_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "gl_state_cache.hpp"
+
+// CPU mirror of the std140 "Camera" uniform block declared in the shaders.
+// Two mat4s need no padding under std140.
+struct CameraUniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+};
+
+// Uniform buffer holding the per-frame camera matrices. It is uploaded once
+// per frame and shared by every program bound to BINDING, instead of each
+// program receiving its own view/projection uniforms.
+class CameraUniformBuffer {
+  public:
+    static constexpr unsigned int BINDING = 0;
+    static constexpr const char *BLOCK_NAME = "Camera";
+
+    unsigned int ID = 0;
+
+    void Create() {
+        glGenBuffers(1, &ID);
+        GLStateCache::Get().BindBufferBase(GL_UNIFORM_BUFFER, BINDING, ID);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraUniforms), nullptr,
+                     GL_DYNAMIC_DRAW);
+    }
+
+    void Upload(const glm::mat4 &view, const glm::mat4 &projection) {
+        CameraUniforms uniforms{view, projection};
+        GLStateCache::Get().BindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraUniforms), &uniforms);
+    }
+
+    void Destroy() {
+        GLStateCache::Get().DeleteBuffer(ID);
+        ID = 0;
+    }
+};
+
+#endif // CAMERA_UNIFORM_BUFFER_HPP
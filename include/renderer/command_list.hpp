@@ -0,0 +1,144 @@
+#ifndef COMMAND_LIST_HPP
+#define COMMAND_LIST_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+#include "instance_buffer.hpp"
+#include "memory/linear_arena.hpp"
+#include "render_queue.hpp"
+
+// Commands a CommandList can hold. Recording them makes no GL calls, so
+// any thread can record; only replaying needs the GL context.
+enum class CommandType : uint32_t {
+    Draw,
+    UploadInstanceIndices,
+};
+
+// A draw for the render queue, with its triangle count for the frame stats
+struct DrawCommand {
+    static constexpr CommandType TYPE = CommandType::Draw;
+
+    RenderQueue::Draw draw;
+    uint64_t triangles = 0;
+};
+
+// New contents for a visible instance list; the indices follow the command
+struct UploadInstanceIndicesCommand {
+    static constexpr CommandType TYPE = CommandType::UploadInstanceIndices;
+
+    VisibleInstanceList *target = nullptr;
+    uint32_t count = 0;
+
+    uint32_t *Indices() { return reinterpret_cast<uint32_t *>(this + 1); }
+    const uint32_t *Indices() const { return reinterpret_cast<const uint32_t *>(this + 1); }
+};
+
+// A frame's worth of commands for one scene partition or pass, recorded
+// by one thread at a time into the list's own arena. Commands are chained
+// in recording order and stay valid until Reset(). The GL thread replays
+// all lists of a frame, merging their draws into one render queue.
+class CommandList {
+  public:
+    struct Header {
+        const Header *next;
+        CommandType type;
+    };
+
+    explicit CommandList(size_t arenaBlockSize = 64 * 1024) : arena(arenaBlockSize) {}
+
+    void Reset() {
+        arena.Reset();
+        first = last = nullptr;
+        count = 0;
+    }
+
+    // Appends a command followed by extraBytes of payload (see
+    // UploadInstanceIndicesCommand), and returns it for filling in
+    template <typename Command> Command &Record(size_t extraBytes = 0) {
+        static_assert(std::is_trivially_destructible_v<Command>, "commands are never destroyed");
+        static_assert(alignof(Command) <= alignof(std::max_align_t), "over-aligned command");
+        constexpr size_t commandOffset = (sizeof(Header) + alignof(Command) - 1) / alignof(Command) * alignof(Command);
+
+        uint8_t *storage = static_cast<uint8_t *>(arena.Allocate(commandOffset + sizeof(Command) + extraBytes));
+        Header *header = new (storage) Header{nullptr, Command::TYPE};
+        if (last) {
+            last->next = header;
+        } else {
+            first = header;
+        }
+        last = header;
+        count++;
+        return *new (storage + commandOffset) Command();
+    }
+
+    void Draw(const RenderQueue::Draw &draw, uint64_t triangles) {
+        DrawCommand &command = Record<DrawCommand>();
+        command.draw = draw;
+        command.triangles = triangles;
+    }
+
+    void UploadInstanceIndices(VisibleInstanceList &target, const uint32_t *indices, uint32_t indexCount) {
+        UploadInstanceIndicesCommand &command = Record<UploadInstanceIndicesCommand>(indexCount * sizeof(uint32_t));
+        command.target = &target;
+        command.count = indexCount;
+        std::memcpy(command.Indices(), indices, indexCount * sizeof(uint32_t));
+    }
+
+    size_t Count() const { return count; }
+    const LinearArena &Arena() const { return arena; }
+
+    // Calls visitor(const Command &) for every command, in recording order
+    template <typename Visitor> void ForEach(Visitor &&visitor) const {
+        for (const Header *header = first; header; header = header->next) {
+            switch (header->type) {
+            case CommandType::Draw:
+                visitor(CommandAt<DrawCommand>(header));
+                break;
+            case CommandType::UploadInstanceIndices:
+                visitor(CommandAt<UploadInstanceIndicesCommand>(header));
+                break;
+            }
+        }
+    }
+
+  private:
+    template <typename Command> static const Command &CommandAt(const Header *header) {
+        constexpr size_t commandOffset = (sizeof(Header) + alignof(Command) - 1) / alignof(Command) * alignof(Command);
+        return *reinterpret_cast<const Command *>(reinterpret_cast<const uint8_t *>(header) + commandOffset);
+    }
+
+    LinearArena arena;
+    Header *first = nullptr;
+    Header *last = nullptr;
+    size_t count = 0;
+};
+
+// Replays command lists on the GL thread: uploads run in list order, and the
+// draws of all lists are merged into the render queue, which sorts them
+// across lists before submission. Returns the triangles of the draws.
+inline uint64_t ReplayCommandLists(CommandList *const *lists, size_t listCount, RenderQueue &queue) {
+    struct Replayer {
+        RenderQueue &queue;
+        uint64_t triangles;
+
+        void operator()(const DrawCommand &command) {
+            queue.Push(command.draw);
+            triangles += command.triangles;
+        }
+        void operator()(const UploadInstanceIndicesCommand &command) {
+            command.target->Upload(command.Indices(), command.count);
+        }
+    };
+
+    Replayer replayer{queue, 0};
+    for (size_t i = 0; i < listCount; i++) {
+        lists[i]->ForEach(replayer);
+    }
+    return replayer.triangles;
+}
+
+#endif // COMMAND_LIST_HPP
@@ -0,0 +1,220 @@
+#ifndef GEOMETRY_ARENA_HPP
+#define GEOMETRY_ARENA_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <iostream>
+
+#include "gl_state_cache.hpp"
+#include "memory/range_allocator.hpp"
+#include "mesh/mesh_format.hpp"
+#include "scene/aabb.hpp"
+
+// Draw parameters in the layout glMultiDrawElementsIndirect reads from
+// GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "layout is defined by GL");
+
+// A mesh living in a GeometryArena: ranges of its shared buffers. A
+// default-constructed mesh has no indices and draws nothing.
+struct ArenaMesh {
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    int32_t baseVertex = 0;
+    uint32_t vertexCount = 0;
+    AABB Bounds;
+    // Turns stored (possibly quantized) positions back into model space;
+    // vertex shaders apply it through their positionOffset/positionScale
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+    glm::vec3 positionScale = glm::vec3(1.0f);
+
+    bool IsLoaded() const { return indexCount > 0; }
+    uint32_t TriangleCount() const { return indexCount / 3; }
+
+    DrawElementsIndirectCommand Command(uint32_t instanceCount, uint32_t baseInstance) const {
+        return {indexCount, instanceCount, firstIndex, baseVertex, baseInstance};
+    }
+};
+
+// One vertex buffer, one 32-bit index buffer and one VAO shared by every
+// mesh of a vertex layout. Meshes are suballocated from them, so drawing
+// any number of them needs a single VAO bind, and their draws can be
+// batched into one multi-draw. Buffers grow by doubling as meshes are added;
+// ranges that are freed again are reused by later allocations.
+class GeometryArena {
+  public:
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+
+    void Create(MeshVertexLayout layout, uint32_t vertexCapacity, uint32_t indexCapacity) {
+        this->layout = layout;
+        stride = MeshVertexStride(layout);
+        vertexRanges.Reset(vertexCapacity);
+        indexRanges.Reset(indexCapacity);
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        GLStateCache &state = GLStateCache::Get();
+        state.BindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(vertexCapacity) * stride, nullptr, GL_STATIC_DRAW);
+
+        state.BindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(indexCapacity) * sizeof(uint32_t), nullptr, GL_STATIC_DRAW);
+
+        AttachBuffers();
+    }
+
+    MeshVertexLayout Layout() const { return layout; }
+
+    // Reserves room for the mesh described by the header. Its data is filled
+    // in afterwards with UploadVertices/UploadIndices, possibly over several
+    // frames; don't draw the mesh before that is done.
+    bool Allocate(const MeshFileHeader &header, ArenaMesh &mesh) {
+        if (header.vertexLayout != layout) {
+            std::cerr << "ERROR::GEOMETRY_ARENA::UNSUPPORTED_VERTEX_LAYOUT" << std::endl;
+            return false;
+        }
+
+        mesh = ArenaMesh();
+        mesh.firstIndex = AllocateIndices(header.indexCount);
+        mesh.baseVertex = AllocateVertices(header.vertexCount);
+        mesh.indexCount = header.indexCount;
+        mesh.vertexCount = header.vertexCount;
+        mesh.Bounds = AABB(glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]),
+                           glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]));
+        mesh.positionOffset = glm::vec3(header.positionOffset[0], header.positionOffset[1], header.positionOffset[2]);
+        mesh.positionScale = glm::vec3(header.positionScale[0], header.positionScale[1], header.positionScale[2]);
+        return true;
+    }
+
+    // Reserves count vertices; returns the first, to be used as baseVertex
+    int32_t AllocateVertices(uint32_t count) {
+        uint32_t first;
+        if (!vertexRanges.Allocate(count, first)) {
+            uint32_t used = vertexRanges.End();
+            vertexRanges.Grow(GrowCapacity(vertexRanges.Capacity(), used + count));
+            Grow(VBO, uint64_t(used) * stride, uint64_t(vertexRanges.Capacity()) * stride);
+            AttachBuffers();
+            vertexRanges.Allocate(count, first);
+        }
+        return int32_t(first);
+    }
+
+    // Reserves count indices; returns the first
+    uint32_t AllocateIndices(uint32_t count) {
+        uint32_t first;
+        if (!indexRanges.Allocate(count, first)) {
+            uint32_t used = indexRanges.End();
+            indexRanges.Grow(GrowCapacity(indexRanges.Capacity(), used + count));
+            Grow(EBO, uint64_t(used) * sizeof(uint32_t), uint64_t(indexRanges.Capacity()) * sizeof(uint32_t));
+            AttachBuffers();
+            indexRanges.Allocate(count, first);
+        }
+        return first;
+    }
+
+    // Gives a mesh's storage back. Meshes may share index ranges (see
+    // Terrain), so vertices and indices are freed separately.
+    void FreeVertices(int32_t baseVertex, uint32_t count) { vertexRanges.Free(uint32_t(baseVertex), count); }
+    void FreeIndices(uint32_t firstIndex, uint32_t count) { indexRanges.Free(firstIndex, count); }
+
+    // Writes bytes [offset, offset + size) of the mesh's vertex block
+    void UploadVertices(const ArenaMesh &mesh, uint64_t offset, const void *data, uint64_t size) {
+        GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, GLintptr(uint64_t(mesh.baseVertex) * stride + offset),
+                        GLsizeiptr(size), data);
+    }
+
+    // Writes indices [first, first + count) of the mesh. They stay relative
+    // to the mesh; baseVertex offsets them at draw time.
+    void UploadIndices(const ArenaMesh &mesh, uint32_t first, const uint32_t *indices, uint32_t count) {
+        // Bound to the copy target so the bound VAO's element buffer stays
+        GLStateCache::Get().BindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, GLintptr(uint64_t(mesh.firstIndex + first) * sizeof(uint32_t)),
+                        GLsizeiptr(uint64_t(count) * sizeof(uint32_t)), indices);
+    }
+
+    // Draws one mesh without instancing; the arena's VAO must be bound
+    static void Draw(const ArenaMesh &mesh) {
+        glDrawElementsBaseVertex(GL_TRIANGLES, GLsizei(mesh.indexCount), GL_UNSIGNED_INT,
+                                 (void *)(uintptr_t(mesh.firstIndex) * sizeof(uint32_t)), mesh.baseVertex);
+    }
+
+    void Destroy() {
+        GLStateCache &state = GLStateCache::Get();
+        state.DeleteVertexArray(VAO);
+        state.DeleteBuffer(VBO);
+        state.DeleteBuffer(EBO);
+        VAO = VBO = EBO = 0;
+        vertexRanges.Reset(0);
+        indexRanges.Reset(0);
+    }
+
+  private:
+    static uint32_t GrowCapacity(uint32_t capacity, uint32_t required) {
+        while (capacity < required) {
+            capacity = capacity ? capacity * 2 : 1024;
+        }
+        return capacity;
+    }
+
+    // Replaces buffer by a larger one holding the same first usedBytes
+    static void Grow(unsigned int &buffer, uint64_t usedBytes, uint64_t newBytes) {
+        GLStateCache &state = GLStateCache::Get();
+        unsigned int grown;
+        glGenBuffers(1, &grown);
+        state.BindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(newBytes), nullptr, GL_STATIC_DRAW);
+        state.BindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, GLsizeiptr(usedBytes));
+        state.DeleteBuffer(buffer);
+        buffer = grown;
+    }
+
+    static GLenum AttributeType(VertexAttributeType type) {
+        switch (type) {
+        case VertexAttributeType::Float32: return GL_FLOAT;
+        case VertexAttributeType::Half: return GL_HALF_FLOAT;
+        case VertexAttributeType::Snorm16: return GL_SHORT;
+        case VertexAttributeType::Unorm8: return GL_UNSIGNED_BYTE;
+        case VertexAttributeType::Snorm10_10_10_2: return GL_INT_2_10_10_10_REV;
+        }
+        return GL_FLOAT;
+    }
+
+    // Points the VAO at the current buffers, with the attributes the vertex
+    // format describes. Other attributes of the VAO (e.g. per-instance ones)
+    // keep their own buffers.
+    void AttachBuffers() {
+        GLStateCache &state = GLStateCache::Get();
+        state.BindVertexArray(VAO);
+        state.BindBuffer(GL_ARRAY_BUFFER, VBO);
+        state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+        const VertexFormat &format = GetVertexFormat(layout);
+        for (uint32_t i = 0; i < format.attributeCount; i++) {
+            const VertexAttribute &attribute = format.attributes[i];
+            glVertexAttribPointer(attribute.location, GLint(attribute.components), AttributeType(attribute.type),
+                                  attribute.normalized ? GL_TRUE : GL_FALSE, GLsizei(stride),
+                                  (void *)uintptr_t(attribute.offset));
+            glEnableVertexAttribArray(attribute.location);
+        }
+    }
+
+    MeshVertexLayout layout = MeshVertexLayout::PositionColor;
+    uint32_t stride = 0;
+    RangeAllocator vertexRanges;
+    RangeAllocator indexRanges;
+};
+
+#endif // GEOMETRY_ARENA_HPP
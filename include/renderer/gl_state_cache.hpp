@@ -0,0 +1,257 @@
+#ifndef GL_STATE_CACHE_HPP
+#define GL_STATE_CACHE_HPP
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+// Mirror of the GL bindings and fixed-function state the renderer touches.
+// Every bind goes through it, and calls that would not change anything are
+// skipped. Code using it binds what it needs and leaves it bound; nothing
+// restores bindings to 0 any more.
+//
+// Only valid on the thread that owns the GL context. After anything changes
+// state behind its back (e.g. a new context), call Invalidate().
+class GLStateCache {
+  public:
+    static constexpr unsigned int MAX_TEXTURE_UNITS = 16;
+
+    // GL calls made and skipped since the last ResetCounters()
+    struct Counters {
+        uint64_t issued = 0;
+        uint64_t elided = 0;
+    };
+
+    static GLStateCache &Get() {
+        static GLStateCache cache;
+        return cache;
+    }
+
+    // Forgets everything, so the next call of each kind is issued
+    void Invalidate() {
+        program = UNKNOWN;
+        vertexArray = UNKNOWN;
+        for (unsigned int &buffer : buffers) {
+            buffer = UNKNOWN;
+        }
+        activeTexture = UNKNOWN;
+        for (auto &unit : textures) {
+            for (unsigned int &texture : unit) {
+                texture = UNKNOWN;
+            }
+        }
+        for (int &capability : capabilities) {
+            capability = -1;
+        }
+        depthFunc = blendSrc = blendDst = cullFaceMode = UNKNOWN;
+        depthMask = -1;
+    }
+
+    void UseProgram(unsigned int id) {
+        if (Changed(program, id)) {
+            glUseProgram(id);
+        }
+    }
+
+    void BindVertexArray(unsigned int id) {
+        if (Changed(vertexArray, id)) {
+            glBindVertexArray(id);
+        }
+    }
+
+    // The element array binding is part of the bound VAO, so it is never
+    // cached: binding it always goes to GL.
+    void BindBuffer(GLenum target, unsigned int id) {
+        int slot = BufferSlot(target);
+        if (slot < 0) {
+            Issued();
+            glBindBuffer(target, id);
+        } else if (Changed(buffers[slot], id)) {
+            glBindBuffer(target, id);
+        }
+    }
+
+    // Indexed bindings are not cached, but they also replace the generic one
+    void BindBufferBase(GLenum target, unsigned int index, unsigned int id) {
+        Issued();
+        glBindBufferBase(target, index, id);
+        int slot = BufferSlot(target);
+        if (slot >= 0) {
+            buffers[slot] = id;
+        }
+    }
+
+    void BindTexture(unsigned int unit, GLenum target, unsigned int id) {
+        int slot = TextureSlot(target);
+        if (slot < 0 || unit >= MAX_TEXTURE_UNITS) {
+            ActiveTexture(unit);
+            Issued();
+            glBindTexture(target, id);
+        } else if (textures[unit][slot] == id) {
+            counters.elided++;
+        } else {
+            ActiveTexture(unit);
+            Issued();
+            textures[unit][slot] = id;
+            glBindTexture(target, id);
+        }
+    }
+
+    void SetCapability(GLenum capability, bool enabled) {
+        int slot = CapabilitySlot(capability);
+        if (slot >= 0 && capabilities[slot] == int(enabled)) {
+            counters.elided++;
+            return;
+        }
+        Issued();
+        if (slot >= 0) {
+            capabilities[slot] = int(enabled);
+        }
+        if (enabled) {
+            glEnable(capability);
+        } else {
+            glDisable(capability);
+        }
+    }
+
+    void DepthFunc(GLenum func) {
+        if (Changed(depthFunc, func)) {
+            glDepthFunc(func);
+        }
+    }
+
+    void DepthMask(bool write) {
+        if (depthMask == int(write)) {
+            counters.elided++;
+            return;
+        }
+        Issued();
+        depthMask = int(write);
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    void BlendFunc(GLenum src, GLenum dst) {
+        if (blendSrc == src && blendDst == dst) {
+            counters.elided++;
+            return;
+        }
+        Issued();
+        blendSrc = src;
+        blendDst = dst;
+        glBlendFunc(src, dst);
+    }
+
+    void CullFace(GLenum mode) {
+        if (Changed(cullFaceMode, mode)) {
+            glCullFace(mode);
+        }
+    }
+
+    // Deleting a bound object unbinds it, and its name may be handed out
+    // again; these keep the mirror in step with that
+    void DeleteProgram(unsigned int id) {
+        if (program == id) {
+            program = 0;
+        }
+        glDeleteProgram(id);
+    }
+
+    void DeleteVertexArray(unsigned int id) {
+        if (vertexArray == id) {
+            vertexArray = 0;
+        }
+        glDeleteVertexArrays(1, &id);
+    }
+
+    void DeleteBuffer(unsigned int id) {
+        for (unsigned int &buffer : buffers) {
+            if (buffer == id) {
+                buffer = 0;
+            }
+        }
+        glDeleteBuffers(1, &id);
+    }
+
+    void DeleteTexture(unsigned int id) {
+        for (auto &unit : textures) {
+            for (unsigned int &texture : unit) {
+                if (texture == id) {
+                    texture = 0;
+                }
+            }
+        }
+        glDeleteTextures(1, &id);
+    }
+
+    const Counters &GetCounters() const { return counters; }
+    void ResetCounters() { counters = Counters(); }
+
+  private:
+    static constexpr unsigned int UNKNOWN = 0xffffffffu;
+
+    enum BufferTarget { ARRAY, COPY_READ, COPY_WRITE, DRAW_INDIRECT, TEXTURE, UNIFORM, BUFFER_TARGET_COUNT };
+    enum TextureTarget { TEXTURE_2D, TEXTURE_BUFFER, TEXTURE_TARGET_COUNT };
+    enum Capability { DEPTH_TEST, BLEND, CULL_FACE, CAPABILITY_COUNT };
+
+    GLStateCache() { Invalidate(); }
+
+    static int BufferSlot(GLenum target) {
+        switch (target) {
+        case GL_ARRAY_BUFFER: return ARRAY;
+        case GL_COPY_READ_BUFFER: return COPY_READ;
+        case GL_COPY_WRITE_BUFFER: return COPY_WRITE;
+        case GL_DRAW_INDIRECT_BUFFER: return DRAW_INDIRECT;
+        case GL_TEXTURE_BUFFER: return TEXTURE;
+        case GL_UNIFORM_BUFFER: return UNIFORM;
+        default: return -1;
+        }
+    }
+
+    static int TextureSlot(GLenum target) {
+        switch (target) {
+        case GL_TEXTURE_2D: return TEXTURE_2D;
+        case GL_TEXTURE_BUFFER: return TEXTURE_BUFFER;
+        default: return -1;
+        }
+    }
+
+    static int CapabilitySlot(GLenum capability) {
+        switch (capability) {
+        case GL_DEPTH_TEST: return DEPTH_TEST;
+        case GL_BLEND: return BLEND;
+        case GL_CULL_FACE: return CULL_FACE;
+        default: return -1;
+        }
+    }
+
+    void ActiveTexture(unsigned int unit) {
+        if (Changed(activeTexture, unit)) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+        }
+    }
+
+    // Records value and counts the call; returns whether GL must be called
+    bool Changed(unsigned int &cached, unsigned int value) {
+        if (cached == value) {
+            counters.elided++;
+            return false;
+        }
+        cached = value;
+        Issued();
+        return true;
+    }
+
+    void Issued() { counters.issued++; }
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int buffers[BUFFER_TARGET_COUNT];
+    unsigned int activeTexture;
+    unsigned int textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+    int capabilities[CAPABILITY_COUNT];
+    unsigned int depthFunc, blendSrc, blendDst, cullFaceMode;
+    int depthMask;
+    Counters counters;
+};
+
+#endif // GL_STATE_CACHE_HPP
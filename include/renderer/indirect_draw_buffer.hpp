@@ -0,0 +1,83 @@
+#ifndef INDIRECT_DRAW_BUFFER_HPP
+#define INDIRECT_DRAW_BUFFER_HPP
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "geometry_arena.hpp"
+#include "gl_state_cache.hpp"
+#include "instance_buffer.hpp"
+#include "stream_buffer.hpp"
+
+// Submits batches of DrawElementsIndirectCommand against a GeometryArena.
+// Each command draws instanceCount instances of one mesh, reading their
+// instance indices from a VisibleInstanceList starting at baseInstance.
+//
+// With ARB_multi_draw_indirect (and ARB_base_instance, for baseInstance to
+// be honored) the whole batch is one glMultiDrawElementsIndirect call.
+// Otherwise every command becomes a glDrawElementsInstancedBaseVertex with
+// the instance index attribute rebased to its baseInstance. That is what
+// glMultiDrawElementsBaseVertex cannot do: it has no per-draw instance
+// offset, so all of its draws would read the same instance indices.
+// The commands are streamed through a StreamBuffer.
+class IndirectDrawBuffer {
+  public:
+    // capacity is the most commands per batch
+    void Create(size_t capacity, StreamBuffer &stream) {
+        this->capacity = capacity;
+        this->stream = &stream;
+    }
+
+    static bool IsMultiDrawSupported() {
+#if defined(GL_ARB_multi_draw_indirect) && defined(GL_ARB_base_instance)
+        return GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_base_instance;
+#else
+        return false;
+#endif
+    }
+
+    // Issues the commands; the arena's VAO, which instances is attached to,
+    // must be bound. Returns the number of GL draw calls it took.
+    int Draw(const std::vector<DrawElementsIndirectCommand> &commands, const VisibleInstanceList &instances) {
+        if (commands.empty()) {
+            return 0;
+        }
+
+#if defined(GL_ARB_multi_draw_indirect) && defined(GL_ARB_base_instance)
+        // a full stream falls back to one draw per command
+        size_t offset;
+        GLsizei count = GLsizei(commands.size());
+        if (IsMultiDrawSupported() && commands.size() <= capacity &&
+            stream->Write(commands.data(), count * sizeof(DrawElementsIndirectCommand), sizeof(uint32_t), offset)) {
+            GLStateCache::Get().BindBuffer(GL_DRAW_INDIRECT_BUFFER, stream->ID);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)uintptr_t(offset), count, 0);
+            return 1;
+        }
+#endif
+
+        uint32_t attributeBase = 0;
+        for (const DrawElementsIndirectCommand &command : commands) {
+            if (command.baseInstance != attributeBase) {
+                instances.RebaseAttribute(command.baseInstance);
+                attributeBase = command.baseInstance;
+            }
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, GLsizei(command.count), GL_UNSIGNED_INT,
+                                              (void *)(uintptr_t(command.firstIndex) * sizeof(uint32_t)),
+                                              GLsizei(command.instanceCount), command.baseVertex);
+        }
+        if (attributeBase != 0) {
+            instances.RebaseAttribute(0);
+        }
+        return int(commands.size());
+    }
+
+  private:
+    size_t capacity = 0;
+    StreamBuffer *stream = nullptr;
+};
+
+#endif // INDIRECT_DRAW_BUFFER_HPP
@@ -0,0 +1,209 @@
+#ifndef INSTANCE_BUFFER_HPP
+#define INSTANCE_BUFFER_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "gl_state_cache.hpp"
+#include "stream_buffer.hpp"
+
+// Per-instance data consumed by shaders/instanced.vs, which reads it from a
+// texture buffer as TEXELS_PER_INSTANCE RGBA32F texels (model columns, color).
+struct InstanceData {
+    glm::mat4 model;
+    glm::vec4 color;
+};
+
+// Owns the GL buffers of InstanceData, exposed to shaders as a samplerBuffer
+// so draws can pick any subset of instances by index (see
+// VisibleInstanceList).
+//
+// The instances change every frame, so there is one copy per frame in
+// flight, rotated like the regions of a StreamBuffer: each frame writes the
+// copy the GPU finished with FRAMES frames ago, guarded by a fence, and the
+// texture is re-pointed at it. With ARB_buffer_storage the copies are mapped
+// once, persistently; otherwise each write maps its range unsynchronized.
+// Orphaning is not an option, as unchanged instances must survive. Callers
+// track per copy what it already holds (see Region()).
+class InstanceBuffer {
+  public:
+    static constexpr int TEXELS_PER_INSTANCE = sizeof(InstanceData) / sizeof(glm::vec4);
+    static constexpr unsigned int FRAMES = StreamBuffer::FRAMES;
+
+    unsigned int Texture = 0;
+    GLsizei Count = 0;
+
+    // creates the buffers and their texture view and uploads the instances
+    // into every copy
+    void Create(const std::vector<InstanceData> &instances) {
+        Count = static_cast<GLsizei>(instances.size());
+        const GLsizeiptr size = GLsizeiptr(instances.size() * sizeof(InstanceData));
+
+        GLStateCache &state = GLStateCache::Get();
+        glGenBuffers(FRAMES, buffers);
+        for (unsigned int i = 0; i < FRAMES; i++) {
+            state.BindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+#if defined(GL_ARB_buffer_storage)
+            if (StreamBuffer::IsPersistentMappingSupported()) {
+                const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                glBufferStorage(GL_TEXTURE_BUFFER, size, instances.data(), flags);
+                mapped[i] = static_cast<InstanceData *>(glMapBufferRange(GL_TEXTURE_BUFFER, 0, size, flags));
+            }
+#endif
+            if (!mapped[i]) {
+                glBufferData(GL_TEXTURE_BUFFER, size, instances.data(), GL_DYNAMIC_DRAW);
+            }
+        }
+
+        glGenTextures(1, &Texture);
+        region = FRAMES - 1;
+        PointTexture();
+    }
+
+    // Moves on to the next copy, waiting if the GPU still reads it, and
+    // makes the texture read from it
+    void BeginFrame() {
+        region = (region + 1) % FRAMES;
+        if (fences[region]) {
+            // Normally long signaled; only blocks if the CPU runs FRAMES
+            // frames ahead of the GPU
+            if (glClientWaitSync(fences[region], 0, 0) == GL_TIMEOUT_EXPIRED) {
+                while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+                }
+            }
+            glDeleteSync(fences[region]);
+            fences[region] = nullptr;
+        }
+        PointTexture();
+    }
+
+    // Fences the copy; call after the last draw reading this frame's instances
+    void EndFrame() {
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // which copy this frame writes and draws from, in [0, FRAMES)
+    unsigned int Region() const { return region; }
+
+    // Maps instances [first, first + count) of this frame's copy for writing
+    // without discarding them, so callers can rewrite only the instances
+    // that changed. The returned pointer addresses instance `first`.
+    InstanceData *MapRange(GLsizei first, GLsizei count) {
+        if (mapped[region]) {
+            return mapped[region] + first;
+        }
+        GLStateCache::Get().BindBuffer(GL_TEXTURE_BUFFER, buffers[region]);
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        return static_cast<InstanceData *>(glMapBufferRange(
+            GL_TEXTURE_BUFFER, first * sizeof(InstanceData),
+            count * sizeof(InstanceData), flags));
+    }
+
+    void Unmap() {
+        if (mapped[region]) {
+            return;
+        }
+        GLStateCache::Get().BindBuffer(GL_TEXTURE_BUFFER, buffers[region]);
+        glUnmapBuffer(GL_TEXTURE_BUFFER);
+    }
+
+    void BindTexture(unsigned int unit) const {
+        GLStateCache::Get().BindTexture(unit, GL_TEXTURE_BUFFER, Texture);
+    }
+
+    void Destroy() {
+        GLStateCache &state = GLStateCache::Get();
+        for (unsigned int i = 0; i < FRAMES; i++) {
+            if (fences[i]) {
+                glDeleteSync(fences[i]);
+                fences[i] = nullptr;
+            }
+            if (mapped[i]) {
+                state.BindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+                glUnmapBuffer(GL_TEXTURE_BUFFER);
+                mapped[i] = nullptr;
+            }
+            state.DeleteBuffer(buffers[i]);
+            buffers[i] = 0;
+        }
+        state.DeleteTexture(Texture);
+        Texture = 0;
+        Count = 0;
+    }
+
+  private:
+    unsigned int buffers[FRAMES] = {};
+    InstanceData *mapped[FRAMES] = {};
+    GLsync fences[FRAMES] = {};
+    unsigned int region = 0;
+
+    void PointTexture() {
+        GLStateCache::Get().BindTexture(0, GL_TEXTURE_BUFFER, Texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffers[region]);
+    }
+};
+
+// Indices of the instances to draw, fed to the instanced shader as a
+// per-instance integer attribute. Culling fills it each frame, so only
+// visible instances are submitted. The indices are streamed through a
+// StreamBuffer, and the attribute is pointed at wherever they landed.
+class VisibleInstanceList {
+  public:
+    static constexpr unsigned int INDEX_LOCATION = 2;
+
+    GLsizei Count = 0;
+
+    // attaches the list to the given VAO; the stream must have room for
+    // capacity indices per frame
+    void Create(unsigned int vao, size_t capacity, StreamBuffer &stream) {
+        this->vao = vao;
+        this->capacity = capacity;
+        this->stream = &stream;
+        baseOffset = 0;
+
+        GLStateCache::Get().BindVertexArray(vao);
+        RebaseAttribute(0);
+        glEnableVertexAttribArray(INDEX_LOCATION);
+        glVertexAttribDivisor(INDEX_LOCATION, 1);
+    }
+
+    void Upload(const uint32_t *indices, size_t count) {
+        size_t offset;
+        if (!stream->Write(indices, std::min(count, capacity) * sizeof(uint32_t), sizeof(uint32_t), offset)) {
+            Count = 0;
+            return;
+        }
+        Count = static_cast<GLsizei>(std::min(count, capacity));
+        baseOffset = offset;
+        GLStateCache::Get().BindVertexArray(vao);
+        RebaseAttribute(0);
+    }
+
+    void Upload(const std::vector<uint32_t> &indices) { Upload(indices.data(), indices.size()); }
+
+    // Makes instance 0 of the next draws read index `first`; also used for
+    // drivers without base instance support. The owning VAO must be bound.
+    void RebaseAttribute(uint32_t first) const {
+        GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, stream->ID);
+        glVertexAttribIPointer(INDEX_LOCATION, 1, GL_UNSIGNED_INT, sizeof(uint32_t),
+                               (void *)(uintptr_t(baseOffset) + uintptr_t(first) * sizeof(uint32_t)));
+    }
+
+    void Destroy() {
+        Count = 0;
+    }
+
+  private:
+    unsigned int vao = 0;
+    size_t capacity = 0;
+    StreamBuffer *stream = nullptr;
+    // where this frame's indices start in the stream
+    size_t baseOffset = 0;
+};
+
+#endif // INSTANCE_BUFFER_HPP
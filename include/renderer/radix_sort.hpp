@@ -0,0 +1,65 @@
+#ifndef RADIX_SORT_HPP
+#define RADIX_SORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// A 64-bit sort key and the index of the item it belongs to
+struct SortEntry {
+    uint64_t key;
+    uint32_t index;
+};
+
+// Stable LSD radix sort of count entries by key, one byte per pass, using
+// scratch (also count entries) as the second buffer. Returns whichever of
+// the two ends up holding the sorted entries. Passes over bytes that are
+// equal in every key are skipped, so keys that only use their low bits
+// (e.g. depth buckets) cost only as many passes as they need.
+inline SortEntry *RadixSort(SortEntry *entries, SortEntry *scratch, size_t count) {
+    if (count < 2) {
+        return entries;
+    }
+
+    // One histogram per byte, all built in a single read of the keys
+    uint32_t histograms[8][256] = {};
+    for (size_t i = 0; i < count; i++) {
+        for (int byte = 0; byte < 8; byte++) {
+            histograms[byte][(entries[i].key >> (byte * 8)) & 0xff]++;
+        }
+    }
+
+    SortEntry *source = entries;
+    SortEntry *destination = scratch;
+    for (int byte = 0; byte < 8; byte++) {
+        uint32_t *histogram = histograms[byte];
+        const uint32_t firstDigit = (source[0].key >> (byte * 8)) & 0xff;
+        if (histogram[firstDigit] == count) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            uint32_t digitCount = histogram[digit];
+            histogram[digit] = offset;
+            offset += digitCount;
+        }
+        for (size_t i = 0; i < count; i++) {
+            destination[histogram[(source[i].key >> (byte * 8)) & 0xff]++] = source[i];
+        }
+        std::swap(source, destination);
+    }
+    return source;
+}
+
+// The same on vectors; scratch is resized as needed and can be reused
+// across calls
+inline void RadixSort(std::vector<SortEntry> &entries, std::vector<SortEntry> &scratch) {
+    scratch.resize(entries.size());
+    if (RadixSort(entries.data(), scratch.data(), entries.size()) != entries.data()) {
+        entries.swap(scratch);
+    }
+}
+
+#endif // RADIX_SORT_HPP
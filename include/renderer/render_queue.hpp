@@ -0,0 +1,177 @@
+#ifndef RENDER_QUEUE_HPP
+#define RENDER_QUEUE_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "geometry_arena.hpp"
+#include "gl_state_cache.hpp"
+#include "indirect_draw_buffer.hpp"
+#include "instance_buffer.hpp"
+#include "radix_sort.hpp"
+#include "shader/shader.hpp"
+
+// Collects the draws of a frame, sorts them by a 64-bit key and submits
+// them with as few state changes as possible. From the most significant bit:
+//
+//   pass (4) | program (12) | material (12) | VAO (12) | depth (24)
+//
+// so draws are grouped by pass, then by program, material and VAO, and
+// within a group opaque draws go front to back for early-Z while
+// transparent ones go back to front. Program and VAO fields hold the low
+// bits of the GL names; a collision only costs grouping, since submission
+// compares the actual objects. Consecutive instanced draws sharing all
+// state are merged into one multi-draw. The per-mesh position
+// dequantization is a uniform, so only draws of meshes sharing it merge.
+class RenderQueue {
+  public:
+    enum class Pass : uint8_t { Opaque = 0, Transparent = 1 };
+
+    // Textures bound for a draw; material 0 binds none
+    struct Material {
+        unsigned int unit = 0;
+        GLenum target = GL_TEXTURE_2D;
+        unsigned int texture = 0;
+    };
+
+    struct Draw {
+        Pass pass = Pass::Opaque;
+        Shader *program = nullptr;
+        unsigned int vao = 0;
+        uint16_t material = 0;
+        // distance from the eye, for the depth bucket
+        float depth = 0.0f;
+        DrawElementsIndirectCommand command = {};
+        // the mesh's ArenaMesh::positionOffset/positionScale, and where the
+        // program takes them
+        glm::vec3 positionOffset = glm::vec3(0.0f);
+        glm::vec3 positionScale = glm::vec3(1.0f);
+        int positionOffsetLocation = -1;
+        int positionScaleLocation = -1;
+        // Instanced draws read per-instance indices from the list passed to
+        // Submit(), starting at command.baseInstance. Others are drawn once
+        // with model uploaded to modelLocation.
+        bool instanced = true;
+        int modelLocation = -1;
+        glm::mat4 model = glm::mat4(1.0f);
+    };
+
+    RenderQueue() { materials.push_back(Material()); }
+
+    uint16_t AddMaterial(const Material &material) {
+        materials.push_back(material);
+        return uint16_t(materials.size() - 1);
+    }
+
+    // Starts a new frame; depths are bucketed over [0, farPlane]
+    void Clear(float farPlane) {
+        draws.clear();
+        depthScale = float(DEPTH_MASK) / farPlane;
+    }
+
+    void Push(const Draw &draw) { draws.push_back(draw); }
+
+    bool Empty() const { return draws.empty(); }
+
+    void Sort() {
+        sortEntries.resize(draws.size());
+        for (size_t i = 0; i < draws.size(); i++) {
+            sortEntries[i] = {MakeKey(draws[i]), uint32_t(i)};
+        }
+        RadixSort(sortEntries, scratch);
+    }
+
+    // Issues the sorted draws; returns the number of GL draw calls it took
+    int Submit(IndirectDrawBuffer &indirectDraws, const VisibleInstanceList &instances) {
+        GLStateCache &state = GLStateCache::Get();
+        int drawCalls = 0;
+        const Draw *current = nullptr;
+
+        auto flush = [&]() {
+            if (!batch.empty()) {
+                drawCalls += indirectDraws.Draw(batch, instances);
+                batch.clear();
+            }
+        };
+
+        for (const SortEntry &entry : sortEntries) {
+            const Draw &draw = draws[entry.index];
+            if (!current || !SameState(*current, draw)) {
+                flush();
+                ApplyPass(draw.pass);
+                draw.program->use();
+                BindMaterial(draw.material);
+                state.BindVertexArray(draw.vao);
+                draw.program->setVec3(draw.positionOffsetLocation, draw.positionOffset);
+                draw.program->setVec3(draw.positionScaleLocation, draw.positionScale);
+            }
+            current = &draw;
+
+            if (draw.instanced) {
+                batch.push_back(draw.command);
+                continue;
+            }
+
+            flush();
+            draw.program->setMat4(draw.modelLocation, draw.model);
+            glDrawElementsBaseVertex(GL_TRIANGLES, GLsizei(draw.command.count), GL_UNSIGNED_INT,
+                                     (void *)(uintptr_t(draw.command.firstIndex) * sizeof(uint32_t)),
+                                     draw.command.baseVertex);
+            drawCalls++;
+        }
+        flush();
+        return drawCalls;
+    }
+
+  private:
+    static constexpr uint64_t DEPTH_MASK = (1u << 24) - 1;
+    static constexpr uint64_t FIELD_MASK = (1u << 12) - 1;
+
+    uint64_t MakeKey(const Draw &draw) const {
+        uint64_t depth = uint64_t(std::clamp(draw.depth * depthScale, 0.0f, float(DEPTH_MASK)));
+        if (draw.pass == Pass::Transparent) {
+            depth = DEPTH_MASK - depth;
+        }
+        return (uint64_t(draw.pass) << 60) |
+               ((uint64_t(draw.program->ID) & FIELD_MASK) << 48) |
+               ((uint64_t(draw.material) & FIELD_MASK) << 36) |
+               ((uint64_t(draw.vao) & FIELD_MASK) << 24) |
+               depth;
+    }
+
+    static bool SameState(const Draw &a, const Draw &b) {
+        return a.pass == b.pass && a.program == b.program && a.material == b.material && a.vao == b.vao &&
+               a.positionOffset == b.positionOffset && a.positionScale == b.positionScale;
+    }
+
+    static void ApplyPass(Pass pass) {
+        GLStateCache &state = GLStateCache::Get();
+        bool transparent = pass == Pass::Transparent;
+        state.SetCapability(GL_BLEND, transparent);
+        state.DepthMask(!transparent);
+        if (transparent) {
+            state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        }
+    }
+
+    void BindMaterial(uint16_t id) {
+        if (id == 0) {
+            return;
+        }
+        const Material &material = materials[id];
+        GLStateCache::Get().BindTexture(material.unit, material.target, material.texture);
+    }
+
+    std::vector<Material> materials;
+    std::vector<Draw> draws;
+    std::vector<SortEntry> sortEntries;
+    std::vector<SortEntry> scratch;
+    std::vector<DrawElementsIndirectCommand> batch;
+    float depthScale = 1.0f;
+};
+
+#endif // RENDER_QUEUE_HPP
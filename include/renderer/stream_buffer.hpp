@@ -0,0 +1,159 @@
+#ifndef STREAM_BUFFER_HPP
+#define STREAM_BUFFER_HPP
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include "gl_state_cache.hpp"
+
+// Ring buffer for data written once per frame and read by that frame's
+// draws (instance indices, indirect commands). It is split into FRAMES
+// regions; each frame suballocates from the next one, so the CPU writes
+// while the GPU still reads the previous frames' regions.
+//
+// With ARB_buffer_storage the buffer is mapped once, persistently and
+// coherently, and writes go straight into it. A fence at the end of each
+// frame guards its region, which is only reused once the GPU is past it.
+// Without the extension every write maps its range unsynchronized, and the
+// buffer is orphaned whenever the ring wraps, so the driver hands out fresh
+// storage instead of waiting for the GPU. Either way there is no driver-side
+// copy and no implicit sync.
+//
+// The buffer has no fixed target: users bind ID wherever they read from it.
+class StreamBuffer {
+  public:
+    static constexpr unsigned int FRAMES = 3;
+    // regions start on this boundary, which satisfies any GL offset alignment
+    static constexpr size_t REGION_ALIGNMENT = 256;
+
+    unsigned int ID = 0;
+
+    static bool IsPersistentMappingSupported() {
+#if defined(GL_ARB_buffer_storage)
+        return GLAD_GL_ARB_buffer_storage;
+#else
+        return false;
+#endif
+    }
+
+    void Create(size_t bytesPerFrame) {
+        regionSize = (bytesPerFrame + REGION_ALIGNMENT - 1) / REGION_ALIGNMENT * REGION_ALIGNMENT;
+        size_t size = regionSize * FRAMES;
+
+        glGenBuffers(1, &ID);
+        GLStateCache::Get().BindBuffer(GL_COPY_WRITE_BUFFER, ID);
+#if defined(GL_ARB_buffer_storage)
+        if (IsPersistentMappingSupported()) {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_COPY_WRITE_BUFFER, GLsizeiptr(size), nullptr, flags);
+            mapped = static_cast<uint8_t *>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, GLsizeiptr(size), flags));
+        }
+#endif
+        if (!mapped) {
+            glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(size), nullptr, GL_STREAM_DRAW);
+        }
+        region = FRAMES - 1;
+        head = end = 0;
+    }
+
+    bool IsPersistent() const { return mapped != nullptr; }
+
+    // Moves on to the next region, waiting if the GPU still reads it
+    void BeginFrame() {
+        region = (region + 1) % FRAMES;
+        head = region * regionSize;
+        end = head + regionSize;
+
+        if (fences[region]) {
+            // Normally long signaled; only blocks if the CPU runs FRAMES
+            // frames ahead of the GPU
+            if (glClientWaitSync(fences[region], 0, 0) == GL_TIMEOUT_EXPIRED) {
+                stalls++;
+                while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+                }
+            }
+            glDeleteSync(fences[region]);
+            fences[region] = nullptr;
+        }
+
+        if (!mapped && region == 0) {
+            GLStateCache::Get().BindBuffer(GL_COPY_WRITE_BUFFER, ID);
+            glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(regionSize * FRAMES), nullptr, GL_STREAM_DRAW);
+        }
+    }
+
+    // Fences the region; call after the last draw reading this frame's data
+    void EndFrame() {
+        if (mapped) {
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+    }
+
+    // Copies size bytes into the current region and returns true with the
+    // offset they were written at, or false if the region is full
+    bool Write(const void *data, size_t size, size_t alignment, size_t &offset) {
+        size_t start = (head + alignment - 1) / alignment * alignment;
+        if (start + size > end) {
+            if (!reportedFull) {
+                std::cerr << "ERROR::STREAM_BUFFER::FRAME_FULL " << regionSize << " bytes" << std::endl;
+                reportedFull = true;
+            }
+            return false;
+        }
+        head = start + size;
+        offset = start;
+        if (size == 0) {
+            return true;
+        }
+
+        if (mapped) {
+            std::memcpy(mapped + start, data, size);
+            return true;
+        }
+        GLStateCache::Get().BindBuffer(GL_COPY_WRITE_BUFFER, ID);
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        void *range = glMapBufferRange(GL_COPY_WRITE_BUFFER, GLintptr(start), GLsizeiptr(size), flags);
+        if (!range) {
+            return false;
+        }
+        std::memcpy(range, data, size);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        return true;
+    }
+
+    // times BeginFrame() had to wait for the GPU
+    uint64_t Stalls() const { return stalls; }
+
+    void Destroy() {
+        for (GLsync &fence : fences) {
+            if (fence) {
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+        if (mapped) {
+            GLStateCache::Get().BindBuffer(GL_COPY_WRITE_BUFFER, ID);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            mapped = nullptr;
+        }
+        GLStateCache::Get().DeleteBuffer(ID);
+        ID = 0;
+    }
+
+  private:
+    size_t regionSize = 0;
+    unsigned int region = 0;
+    // next free byte and end of the current region
+    size_t head = 0;
+    size_t end = 0;
+    uint8_t *mapped = nullptr;
+    GLsync fences[FRAMES] = {};
+    uint64_t stalls = 0;
+    bool reportedFull = false;
+};
+
+#endif // STREAM_BUFFER_HPP
@@ -0,0 +1,36 @@
+#ifndef AABB_HPP
+#define AABB_HPP
+
+#include <glm/glm.hpp>
+
+#include <cfloat>
+
+// Axis-aligned bounding box. Default-constructed boxes are empty, so merging
+// into them yields the other box.
+struct AABB {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    AABB() = default;
+    AABB(const glm::vec3 &min, const glm::vec3 &max) : min(min), max(max) {}
+
+    // box around a sphere, e.g. any rotation of an object with that bounding radius
+    static AABB FromCenterRadius(const glm::vec3 &center, float radius) {
+        return AABB(center - glm::vec3(radius), center + glm::vec3(radius));
+    }
+
+    void Merge(const AABB &other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    glm::vec3 Center() const { return 0.5f * (min + max); }
+    glm::vec3 Extent() const { return max - min; }
+
+    float SurfaceArea() const {
+        glm::vec3 e = Extent();
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+};
+
+#endif // AABB_HPP
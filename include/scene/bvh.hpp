@@ -0,0 +1,181 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "aabb.hpp"
+#include "frustum.hpp"
+
+// Bounding volume hierarchy over object AABBs, used to cull whole groups of
+// objects against the view frustum at once.
+//
+// Objects are reordered at build time so that every node covers a
+// contiguous range of objectIndices; a node fully inside the frustum then
+// emits its whole range without testing anything below it. When objects
+// move, Refit() updates the bounds of the affected nodes bottom-up instead
+// of rebuilding, which keeps per-frame cost proportional to what moved.
+class BoundingVolumeHierarchy {
+  public:
+    static constexpr uint32_t MAX_LEAF_OBJECTS = 4;
+
+    void Build(const std::vector<AABB> &objectBounds) {
+        bounds = objectBounds;
+        nodes.clear();
+        objectIndices.resize(bounds.size());
+        for (uint32_t i = 0; i < objectIndices.size(); ++i) {
+            objectIndices[i] = i;
+        }
+        objectLeaf.assign(bounds.size(), 0);
+        nodeDirty.clear();
+        if (bounds.empty()) {
+            return;
+        }
+
+        nodes.reserve(2 * bounds.size() / MAX_LEAF_OBJECTS + 1);
+        nodes.push_back(Node{});
+        nodes[0].parent = -1;
+        BuildNode(0, 0, static_cast<uint32_t>(bounds.size()));
+        nodeDirty.assign(nodes.size(), 0);
+    }
+
+    size_t ObjectCount() const { return bounds.size(); }
+    const AABB &ObjectBounds(uint32_t object) const { return bounds[object]; }
+
+    // records a new box for an object; takes effect at the next Refit()
+    void UpdateObject(uint32_t object, const AABB &box) {
+        bounds[object] = box;
+        int node = objectLeaf[object];
+        if (!nodeDirty[node]) {
+            nodeDirty[node] = 1;
+            dirtyNodes.push_back(node);
+        }
+    }
+
+    // Recomputes the bounds of every node above an updated object. Children
+    // always come after their parent in the node array, so walking the dirty
+    // nodes from the highest index down sees each child before its parent.
+    void Refit() {
+        if (dirtyNodes.empty()) {
+            return;
+        }
+
+        // mark all ancestors of the touched leaves
+        size_t leafCount = dirtyNodes.size();
+        for (size_t i = 0; i < leafCount; ++i) {
+            for (int node = nodes[dirtyNodes[i]].parent; node >= 0 && !nodeDirty[node]; node = nodes[node].parent) {
+                nodeDirty[node] = 1;
+                dirtyNodes.push_back(node);
+            }
+        }
+        std::sort(dirtyNodes.begin(), dirtyNodes.end(), std::greater<int>());
+
+        for (int index : dirtyNodes) {
+            Node &node = nodes[index];
+            if (node.IsLeaf()) {
+                node.bounds = AABB();
+                for (uint32_t i = node.firstObject; i < node.firstObject + node.objectCount; ++i) {
+                    node.bounds.Merge(bounds[objectIndices[i]]);
+                }
+            } else {
+                node.bounds = nodes[node.leftChild].bounds;
+                node.bounds.Merge(nodes[node.leftChild + 1].bounds);
+            }
+            nodeDirty[index] = 0;
+        }
+        dirtyNodes.clear();
+    }
+
+    // Appends the indices of all objects whose boxes are not fully outside
+    // the frustum
+    void Cull(const Frustum &frustum, std::vector<uint32_t> &visible) const {
+        if (nodes.empty()) {
+            return;
+        }
+
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node &node = nodes[stack[--top]];
+            Frustum::Containment containment = frustum.Test(node.bounds);
+            if (containment == Frustum::Containment::Outside) {
+                continue;
+            }
+
+            if (containment == Frustum::Containment::Inside) {
+                visible.insert(visible.end(), objectIndices.begin() + node.firstObject,
+                               objectIndices.begin() + node.firstObject + node.objectCount);
+            } else if (node.IsLeaf()) {
+                for (uint32_t i = node.firstObject; i < node.firstObject + node.objectCount; ++i) {
+                    if (frustum.IsVisible(bounds[objectIndices[i]])) {
+                        visible.push_back(objectIndices[i]);
+                    }
+                }
+            } else {
+                stack[top++] = node.leftChild + 1;
+                stack[top++] = node.leftChild;
+            }
+        }
+    }
+
+  private:
+    struct Node {
+        AABB bounds;
+        uint32_t firstObject = 0; // range of objectIndices under this node
+        uint32_t objectCount = 0;
+        int leftChild = -1;       // right child is leftChild + 1; -1 for leaves
+        int parent = -1;
+
+        bool IsLeaf() const { return leftChild < 0; }
+    };
+
+    // Median split along the longest axis of the centroids. Depth stays
+    // logarithmic, well within the fixed traversal stack.
+    void BuildNode(int index, uint32_t first, uint32_t count) {
+        AABB nodeBounds, centroidBounds;
+        for (uint32_t i = first; i < first + count; ++i) {
+            const AABB &box = bounds[objectIndices[i]];
+            nodeBounds.Merge(box);
+            centroidBounds.Merge(AABB(box.Center(), box.Center()));
+        }
+        nodes[index].bounds = nodeBounds;
+        nodes[index].firstObject = first;
+        nodes[index].objectCount = count;
+
+        if (count <= MAX_LEAF_OBJECTS) {
+            for (uint32_t i = first; i < first + count; ++i) {
+                objectLeaf[objectIndices[i]] = index;
+            }
+            return;
+        }
+
+        glm::vec3 extent = centroidBounds.Extent();
+        int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+        uint32_t half = count / 2;
+        std::nth_element(objectIndices.begin() + first, objectIndices.begin() + first + half,
+                         objectIndices.begin() + first + count, [&](uint32_t a, uint32_t b) {
+                             return bounds[a].Center()[axis] < bounds[b].Center()[axis];
+                         });
+
+        int left = static_cast<int>(nodes.size());
+        nodes.push_back(Node{});
+        nodes.push_back(Node{});
+        nodes[index].leftChild = left;
+        nodes[left].parent = index;
+        nodes[left + 1].parent = index;
+
+        BuildNode(left, first, half);
+        BuildNode(left + 1, first + half, count - half);
+    }
+
+    std::vector<AABB> bounds;            // per object
+    std::vector<uint32_t> objectIndices; // objects in tree order
+    std::vector<int> objectLeaf;         // leaf node holding each object
+    std::vector<Node> nodes;
+    std::vector<uint8_t> nodeDirty;
+    std::vector<int> dirtyNodes;
+};
+
+#endif // BVH_HPP
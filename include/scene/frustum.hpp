@@ -0,0 +1,118 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define FRUSTUM_SSE 1
+#endif
+
+#include "aabb.hpp"
+
+// View frustum as six inward-facing planes, stored in structure-of-arrays
+// form (padded to eight with planes that accept everything) so a box can be
+// tested against four planes per SSE instruction.
+class Frustum {
+  public:
+    enum class Containment { Outside, Intersecting, Inside };
+
+    // Extracts the planes from a view-projection matrix (Gribb/Hartmann),
+    // assuming OpenGL clip space (-w <= x, y, z <= w)
+    static Frustum FromMatrix(const glm::mat4 &viewProjection) {
+        const glm::mat4 &m = viewProjection;
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        const glm::vec4 planes[6] = {
+            row3 + row0, // left
+            row3 - row0, // right
+            row3 + row1, // bottom
+            row3 - row1, // top
+            row3 + row2, // near
+            row3 - row2, // far
+        };
+
+        Frustum frustum;
+        for (int i = 0; i < PLANE_SLOTS; ++i) {
+            glm::vec4 plane = i < 6 ? planes[i] : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+            if (length > 0.0f) {
+                plane = plane / length;
+            }
+            frustum.nx[i] = plane.x;
+            frustum.ny[i] = plane.y;
+            frustum.nz[i] = plane.z;
+            frustum.d[i] = plane.w;
+        }
+        return frustum;
+    }
+
+    // For every plane, the box corner furthest along the normal decides
+    // whether the box is fully outside, and the nearest corner whether it is
+    // fully inside.
+    Containment Test(const AABB &box) const {
+#if defined(FRUSTUM_SSE)
+        const __m128 minX = _mm_set1_ps(box.min.x), maxX = _mm_set1_ps(box.max.x);
+        const __m128 minY = _mm_set1_ps(box.min.y), maxY = _mm_set1_ps(box.max.y);
+        const __m128 minZ = _mm_set1_ps(box.min.z), maxZ = _mm_set1_ps(box.max.z);
+        const __m128 zero = _mm_setzero_ps();
+
+        bool inside = true;
+        for (int i = 0; i < PLANE_SLOTS; i += 4) {
+            __m128 px = _mm_load_ps(&nx[i]), py = _mm_load_ps(&ny[i]), pz = _mm_load_ps(&nz[i]);
+            __m128 x0 = _mm_mul_ps(px, minX), x1 = _mm_mul_ps(px, maxX);
+            __m128 y0 = _mm_mul_ps(py, minY), y1 = _mm_mul_ps(py, maxY);
+            __m128 z0 = _mm_mul_ps(pz, minZ), z1 = _mm_mul_ps(pz, maxZ);
+            __m128 dist = _mm_load_ps(&d[i]);
+
+            __m128 farthest = _mm_add_ps(_mm_add_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)),
+                                         _mm_add_ps(_mm_max_ps(z0, z1), dist));
+            if (_mm_movemask_ps(_mm_cmplt_ps(farthest, zero))) {
+                return Containment::Outside;
+            }
+
+            __m128 nearest = _mm_add_ps(_mm_add_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)),
+                                        _mm_add_ps(_mm_min_ps(z0, z1), dist));
+            if (_mm_movemask_ps(_mm_cmplt_ps(nearest, zero))) {
+                inside = false;
+            }
+        }
+        return inside ? Containment::Inside : Containment::Intersecting;
+#else
+        bool inside = true;
+        for (int i = 0; i < 6; ++i) {
+            glm::vec3 normal(nx[i], ny[i], nz[i]);
+            glm::vec3 farCorner(normal.x >= 0.0f ? box.max.x : box.min.x,
+                                normal.y >= 0.0f ? box.max.y : box.min.y,
+                                normal.z >= 0.0f ? box.max.z : box.min.z);
+            glm::vec3 nearCorner(normal.x >= 0.0f ? box.min.x : box.max.x,
+                                 normal.y >= 0.0f ? box.min.y : box.max.y,
+                                 normal.z >= 0.0f ? box.min.z : box.max.z);
+            if (glm::dot(normal, farCorner) + d[i] < 0.0f) {
+                return Containment::Outside;
+            }
+            if (glm::dot(normal, nearCorner) + d[i] < 0.0f) {
+                inside = false;
+            }
+        }
+        return inside ? Containment::Inside : Containment::Intersecting;
+#endif
+    }
+
+    bool IsVisible(const AABB &box) const { return Test(box) != Containment::Outside; }
+
+  private:
+    static constexpr int PLANE_SLOTS = 8;
+
+    alignas(16) float nx[PLANE_SLOTS];
+    alignas(16) float ny[PLANE_SLOTS];
+    alignas(16) float nz[PLANE_SLOTS];
+    alignas(16) float d[PLANE_SLOTS];
+};
+
+#endif // FRUSTUM_HPP
@@ -0,0 +1,399 @@
+#ifndef OCCLUSION_CULLER_HPP
+#define OCCLUSION_CULLER_HPP
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define OCCLUSION_CULLER_SSE 1
+#endif
+
+#include "aabb.hpp"
+#include "concurrency/job_system.hpp"
+#include "memory/aligned_allocator.hpp"
+
+// Software occlusion culling. A few large, simple occluders are rasterized
+// on the CPU into a small depth buffer, which is reduced into a
+// hierarchical Z pyramid whose texels hold the farthest depth beneath them.
+// A box is hidden when its nearest depth lies behind every texel its screen
+// rectangle overlaps, on the level where that rectangle spans at most 2x2
+// texels.
+//
+// Occluders must lie inside the geometry they stand for, so they never hide
+// more than it does; leaving one out is always safe. Coverage is sampled at
+// pixel centres, as on the GPU, and each covered pixel gets the farthest
+// depth its triangle reaches over the pixel. At this resolution an object
+// seen only through a gap narrower than a pixel may still be culled, the
+// usual price of a coarse buffer.
+//
+// Depths are window depths in [0, 1] under OpenGL clip conventions. The
+// rows are rasterized in bands on the job threads, four pixels at a time,
+// and each band also builds its part of the finer pyramid levels.
+class OcclusionCuller {
+  public:
+    static constexpr int WIDTH = 256;
+    static constexpr int HEIGHT = 128;
+    // levels down to 8 x 4 texels
+    static constexpr int LEVELS = 6;
+    static constexpr int BAND_LEVELS = 3;
+    static constexpr int BAND_ROWS = 1 << BAND_LEVELS;
+
+    OcclusionCuller() {
+        for (int level = 0; level < LEVELS; level++) {
+            levels[level].assign(size_t(WIDTH >> level) * (HEIGHT >> level), 1.0f);
+        }
+    }
+
+    // Drops the previous frame's occluders; the next ones are seen through
+    // viewProjection
+    void Begin(const glm::mat4 &viewProjection) {
+        this->viewProjection = viewProjection;
+        triangles.clear();
+    }
+
+    // Adds an indexed triangle mesh given in model space. Faces turned away
+    // from the camera are skipped. Not thread-safe.
+    void AddOccluder(const glm::vec3 *vertices, size_t vertexCount, const uint32_t *indices, size_t indexCount,
+                     const glm::mat4 &model) {
+        const glm::mat4 transform = viewProjection * model;
+        clipVertices.resize(vertexCount);
+        outcodes.resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++) {
+            clipVertices[i] = transform * glm::vec4(vertices[i], 1.0f);
+            outcodes[i] = Outcode(clipVertices[i]);
+        }
+
+        for (size_t i = 0; i + 2 < indexCount; i += 3) {
+            uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+            // all outside one plane of the frustum
+            if (outcodes[a] & outcodes[b] & outcodes[c] & ~OUTSIDE_GUARD_BAND) {
+                continue;
+            }
+            glm::vec4 polygon[MAX_POLYGON] = {clipVertices[a], clipVertices[b], clipVertices[c]};
+            int count = 3;
+            if ((outcodes[a] | outcodes[b] | outcodes[c]) & MUST_CLIP) {
+                count = ClipPolygon(polygon, count);
+            }
+            for (int k = 1; k + 1 < count; k++) {
+                AddTriangle(ToWindow(polygon[0]), ToWindow(polygon[k]), ToWindow(polygon[k + 1]));
+            }
+        }
+    }
+
+    // Renders the occluders and builds the pyramid. IsVisible() may be
+    // called from any thread afterwards, until the next Begin().
+    void Rasterize(JobSystem &jobs) {
+        jobs.ParallelFor(HEIGHT / BAND_ROWS, 1, [this](uint32_t begin, uint32_t end) {
+            for (uint32_t band = begin; band < end; band++) {
+                RasterizeBand(int(band));
+            }
+        });
+        for (int level = BAND_LEVELS + 1; level < LEVELS; level++) {
+            Downsample(level, 0, HEIGHT >> level);
+        }
+    }
+
+    bool IsVisible(const AABB &box) const {
+        float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+#if defined(OCCLUSION_CULLER_SSE)
+        // four corners per pass: x and y vary across the lanes, z per pass
+        const __m128 xs = _mm_setr_ps(box.min.x, box.max.x, box.min.x, box.max.x);
+        const __m128 ys = _mm_setr_ps(box.min.y, box.min.y, box.max.y, box.max.y);
+        __m128 lowX = _mm_set1_ps(FLT_MAX), highX = _mm_set1_ps(-FLT_MAX);
+        __m128 lowY = _mm_set1_ps(FLT_MAX), highY = _mm_set1_ps(-FLT_MAX), lowZ = _mm_set1_ps(FLT_MAX);
+        for (float z : {box.min.z, box.max.z}) {
+            __m128 cx = TransformRow(0, xs, ys, z), cy = TransformRow(1, xs, ys, z);
+            __m128 cz = TransformRow(2, xs, ys, z), cw = TransformRow(3, xs, ys, z);
+            // a corner before the near plane: the box reaches the camera
+            if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(cz, cw), _mm_setzero_ps()))) {
+                return true;
+            }
+            __m128 invW = _mm_div_ps(_mm_set1_ps(1.0f), cw);
+            __m128 nx = _mm_mul_ps(cx, invW), ny = _mm_mul_ps(cy, invW), nz = _mm_mul_ps(cz, invW);
+            lowX = _mm_min_ps(lowX, nx);
+            highX = _mm_max_ps(highX, nx);
+            lowY = _mm_min_ps(lowY, ny);
+            highY = _mm_max_ps(highY, ny);
+            lowZ = _mm_min_ps(lowZ, nz);
+        }
+        minX = HorizontalMin(lowX);
+        maxX = HorizontalMax(highX);
+        minY = HorizontalMin(lowY);
+        maxY = HorizontalMax(highY);
+        minZ = HorizontalMin(lowZ);
+#else
+        for (int i = 0; i < 8; i++) {
+            glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y,
+                             (i & 4) ? box.max.z : box.min.z);
+            glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+            if (clip.z < -clip.w) {
+                return true;
+            }
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            minX = std::min(minX, ndc.x);
+            maxX = std::max(maxX, ndc.x);
+            minY = std::min(minY, ndc.y);
+            maxY = std::max(maxY, ndc.y);
+            minZ = std::min(minZ, ndc.z);
+        }
+#endif
+        return IsRectVisible(minX, maxX, minY, maxY, minZ * 0.5f + 0.5f);
+    }
+
+    // triangles rasterized this frame, after clipping and back-face culling
+    size_t TriangleCount() const { return triangles.size(); }
+
+  private:
+    // Triangles are clipped to this many times the viewport's extent, which
+    // keeps window coordinates small enough for exact-enough edge functions
+    static constexpr float GUARD_BAND = 4.0f;
+    // a triangle gains at most one vertex per clip plane
+    static constexpr int MAX_POLYGON = 8;
+
+    // bits of a vertex's outcode: the clip planes it lies outside of
+    static constexpr uint32_t OUTSIDE_LEFT = 1, OUTSIDE_RIGHT = 2, OUTSIDE_BOTTOM = 4, OUTSIDE_TOP = 8;
+    static constexpr uint32_t OUTSIDE_NEAR = 16, OUTSIDE_FAR = 32;
+    static constexpr uint32_t OUTSIDE_GUARD_BAND = 64;
+    // planes triangles are clipped against; the others only reject
+    static constexpr uint32_t MUST_CLIP = OUTSIDE_NEAR | OUTSIDE_GUARD_BAND;
+
+    // A triangle set up for rasterization: three edge functions
+    // a * x + b * y + c, positive inside, and a depth plane, all over window
+    // coordinates in pixels; plus the pixels its bounds cover, with minX a
+    // multiple of four
+    struct Triangle {
+        float a[3], b[3], c[3];
+        float depthX, depthY, depth0;
+        int minX, maxX, minY, maxY;
+    };
+
+    using FloatArray = std::vector<float, AlignedAllocator<float, 16>>;
+
+    static uint32_t Outcode(const glm::vec4 &v) {
+        uint32_t code = 0;
+        code |= v.x < -v.w ? OUTSIDE_LEFT : 0;
+        code |= v.x > v.w ? OUTSIDE_RIGHT : 0;
+        code |= v.y < -v.w ? OUTSIDE_BOTTOM : 0;
+        code |= v.y > v.w ? OUTSIDE_TOP : 0;
+        code |= v.z < -v.w ? OUTSIDE_NEAR : 0;
+        code |= v.z > v.w ? OUTSIDE_FAR : 0;
+        float guard = GUARD_BAND * v.w;
+        code |= v.x < -guard || v.x > guard || v.y < -guard || v.y > guard ? OUTSIDE_GUARD_BAND : 0;
+        return code;
+    }
+
+    // Sutherland-Hodgman against the near plane and the guard band, in
+    // clip space; returns the vertex count left, or 0
+    static int ClipPolygon(glm::vec4 *polygon, int count) {
+        static const glm::vec4 planes[] = {
+            glm::vec4(0.0f, 0.0f, 1.0f, 1.0f),
+            glm::vec4(1.0f, 0.0f, 0.0f, GUARD_BAND),
+            glm::vec4(-1.0f, 0.0f, 0.0f, GUARD_BAND),
+            glm::vec4(0.0f, 1.0f, 0.0f, GUARD_BAND),
+            glm::vec4(0.0f, -1.0f, 0.0f, GUARD_BAND),
+        };
+        glm::vec4 clipped[MAX_POLYGON];
+        for (const glm::vec4 &plane : planes) {
+            int kept = 0;
+            for (int i = 0; i < count; i++) {
+                const glm::vec4 &from = polygon[i];
+                const glm::vec4 &to = polygon[(i + 1) % count];
+                float fromDistance = glm::dot(plane, from), toDistance = glm::dot(plane, to);
+                if (fromDistance >= 0.0f) {
+                    clipped[kept++] = from;
+                }
+                if ((fromDistance >= 0.0f) != (toDistance >= 0.0f)) {
+                    clipped[kept++] = glm::mix(from, to, fromDistance / (fromDistance - toDistance));
+                }
+            }
+            if (kept < 3) {
+                return 0;
+            }
+            std::copy(clipped, clipped + kept, polygon);
+            count = kept;
+        }
+        return count;
+    }
+
+    // pixel coordinates with y up, and window depth
+    static glm::vec3 ToWindow(const glm::vec4 &clip) {
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        return glm::vec3((ndc.x * 0.5f + 0.5f) * WIDTH, (ndc.y * 0.5f + 0.5f) * HEIGHT, ndc.z * 0.5f + 0.5f);
+    }
+
+    void AddTriangle(const glm::vec3 &v0, const glm::vec3 &v1, const glm::vec3 &v2) {
+        // counter-clockwise triangles face the camera
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+        if (!(area > 0.0f)) {
+            return;
+        }
+
+        Triangle triangle;
+        const glm::vec3 *v[3] = {&v0, &v1, &v2};
+        for (int e = 0; e < 3; e++) {
+            const glm::vec3 &from = *v[e], &to = *v[(e + 1) % 3];
+            triangle.a[e] = from.y - to.y;
+            triangle.b[e] = to.x - from.x;
+            triangle.c[e] = from.x * to.y - to.x * from.y;
+        }
+
+        // The depth plane, raised to the farthest depth it reaches over a
+        // pixel so a sample never claims more than the triangle covers
+        triangle.depthX = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+        triangle.depthY = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+        triangle.depth0 = v0.z - triangle.depthX * v0.x - triangle.depthY * v0.y +
+                          0.5f * (std::abs(triangle.depthX) + std::abs(triangle.depthY));
+
+        // pixels whose centres the bounds contain
+        float minX = std::min({v0.x, v1.x, v2.x}), maxX = std::max({v0.x, v1.x, v2.x});
+        float minY = std::min({v0.y, v1.y, v2.y}), maxY = std::max({v0.y, v1.y, v2.y});
+        triangle.minX = std::max(0, int(std::ceil(minX - 0.5f))) & ~3;
+        triangle.maxX = std::min(WIDTH - 1, int(std::floor(maxX - 0.5f)));
+        triangle.minY = std::max(0, int(std::ceil(minY - 0.5f)));
+        triangle.maxY = std::min(HEIGHT - 1, int(std::floor(maxY - 0.5f)));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+            return;
+        }
+        triangles.push_back(triangle);
+    }
+
+    // Clears and renders the band's rows, then builds the pyramid levels
+    // below them
+    void RasterizeBand(int band) {
+        const int rowBegin = band * BAND_ROWS, rowEnd = rowBegin + BAND_ROWS;
+        float *depth = levels[0].data();
+        std::fill(depth + rowBegin * WIDTH, depth + rowEnd * WIDTH, 1.0f);
+
+        for (const Triangle &triangle : triangles) {
+            int firstRow = std::max(triangle.minY, rowBegin), lastRow = std::min(triangle.maxY, rowEnd - 1);
+            for (int y = firstRow; y <= lastRow; y++) {
+                float py = float(y) + 0.5f;
+                float *row = depth + y * WIDTH;
+#if defined(OCCLUSION_CULLER_SSE)
+                const __m128 zero = _mm_setzero_ps();
+                const __m128 a0 = _mm_set1_ps(triangle.a[0]), e0 = _mm_set1_ps(triangle.b[0] * py + triangle.c[0]);
+                const __m128 a1 = _mm_set1_ps(triangle.a[1]), e1 = _mm_set1_ps(triangle.b[1] * py + triangle.c[1]);
+                const __m128 a2 = _mm_set1_ps(triangle.a[2]), e2 = _mm_set1_ps(triangle.b[2] * py + triangle.c[2]);
+                const __m128 dx = _mm_set1_ps(triangle.depthX);
+                const __m128 rowDepth = _mm_set1_ps(triangle.depthY * py + triangle.depth0);
+                __m128 px = _mm_add_ps(_mm_set1_ps(float(triangle.minX)), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+                for (int x = triangle.minX; x <= triangle.maxX; x += 4) {
+                    __m128 inside = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), e0), zero),
+                                               _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), e1), zero));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), e2), zero));
+                    if (_mm_movemask_ps(inside)) {
+                        __m128 z = _mm_add_ps(_mm_mul_ps(dx, px), rowDepth);
+                        __m128 current = _mm_load_ps(row + x);
+                        z = _mm_or_ps(_mm_and_ps(inside, z), _mm_andnot_ps(inside, current));
+                        _mm_store_ps(row + x, _mm_min_ps(current, z));
+                    }
+                    px = _mm_add_ps(px, _mm_set1_ps(4.0f));
+                }
+#else
+                for (int x = triangle.minX; x <= triangle.maxX; x++) {
+                    float px = float(x) + 0.5f;
+                    bool inside = true;
+                    for (int e = 0; e < 3; e++) {
+                        inside = inside && triangle.a[e] * px + triangle.b[e] * py + triangle.c[e] >= 0.0f;
+                    }
+                    if (inside) {
+                        row[x] = std::min(row[x], triangle.depthX * px + triangle.depthY * py + triangle.depth0);
+                    }
+                }
+#endif
+            }
+        }
+
+        for (int level = 1; level <= BAND_LEVELS; level++) {
+            Downsample(level, rowBegin >> level, rowEnd >> level);
+        }
+    }
+
+    // Fills rows [rowBegin, rowEnd) of a level with the farthest depth of
+    // the 2x2 texels below each
+    void Downsample(int level, int rowBegin, int rowEnd) {
+        const int sourceWidth = WIDTH >> (level - 1), width = WIDTH >> level;
+        const float *source = levels[level - 1].data();
+        float *target = levels[level].data();
+        for (int y = rowBegin; y < rowEnd; y++) {
+            const float *upper = source + 2 * y * sourceWidth, *lower = upper + sourceWidth;
+            float *out = target + y * width;
+            int x = 0;
+#if defined(OCCLUSION_CULLER_SSE)
+            for (; x + 4 <= width; x += 4) {
+                __m128 left = _mm_max_ps(_mm_load_ps(upper + 2 * x), _mm_load_ps(lower + 2 * x));
+                __m128 right = _mm_max_ps(_mm_load_ps(upper + 2 * x + 4), _mm_load_ps(lower + 2 * x + 4));
+                _mm_store_ps(out + x, _mm_max_ps(_mm_shuffle_ps(left, right, _MM_SHUFFLE(2, 0, 2, 0)),
+                                                 _mm_shuffle_ps(left, right, _MM_SHUFFLE(3, 1, 3, 1))));
+            }
+#endif
+            for (; x < width; x++) {
+                out[x] = std::max(std::max(upper[2 * x], upper[2 * x + 1]), std::max(lower[2 * x], lower[2 * x + 1]));
+            }
+        }
+    }
+
+    // Tests a normalized device rectangle at window depth nearest
+    bool IsRectVisible(float minX, float maxX, float minY, float maxY, float nearest) const {
+        float left = (minX * 0.5f + 0.5f) * WIDTH, right = (maxX * 0.5f + 0.5f) * WIDTH;
+        float bottom = (minY * 0.5f + 0.5f) * HEIGHT, top = (maxY * 0.5f + 0.5f) * HEIGHT;
+        if (right < 0.0f || top < 0.0f || left >= float(WIDTH) || bottom >= float(HEIGHT)) {
+            return false;
+        }
+        int x0 = int(std::max(left, 0.0f)), x1 = std::min(WIDTH - 1, int(right));
+        int y0 = int(std::max(bottom, 0.0f)), y1 = std::min(HEIGHT - 1, int(top));
+
+        int level = 0;
+        while (level + 1 < LEVELS && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+            level++;
+        }
+        const float *texels = levels[level].data();
+        const int width = WIDTH >> level;
+        for (int y = y0 >> level; y <= y1 >> level; y++) {
+            for (int x = x0 >> level; x <= x1 >> level; x++) {
+                if (nearest <= texels[y * width + x]) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+#if defined(OCCLUSION_CULLER_SSE)
+    // Row r of viewProjection applied to four points sharing z
+    __m128 TransformRow(int r, __m128 xs, __m128 ys, float z) const {
+        const glm::mat4 &m = viewProjection;
+        __m128 sum = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][r]), xs), _mm_mul_ps(_mm_set1_ps(m[1][r]), ys));
+        return _mm_add_ps(sum, _mm_set1_ps(m[2][r] * z + m[3][r]));
+    }
+
+    static float HorizontalMin(__m128 v) {
+        v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(v);
+    }
+
+    static float HorizontalMax(__m128 v) {
+        v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(v);
+    }
+#endif
+
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    std::vector<Triangle> triangles;
+    // scratch of AddOccluder()
+    std::vector<glm::vec4> clipVertices;
+    std::vector<uint32_t> outcodes;
+    // the depth buffer, then ever coarser pyramid levels
+    FloatArray levels[LEVELS];
+};
+
+#endif // OCCLUSION_CULLER_HPP
@@ -0,0 +1,304 @@
+#ifndef TRANSFORM_SYSTEM_HPP
+#define TRANSFORM_SYSTEM_HPP
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define TRANSFORM_SYSTEM_SSE 1
+#endif
+
+#include "memory/aligned_allocator.hpp"
+
+// Entity transforms in structure-of-arrays form: positions, rotations
+// (quaternions) and scales each live in their own float arrays, so local
+// matrices can be composed for 4 (SSE) or 8 (AVX) entities at once.
+//
+// A parent must be created before its children. Entities are kept in
+// creation order, so a single forward pass always sees a parent's world
+// matrix before its children need it. Update() only recomputes entities
+// whose own transform changed and the subtrees below them.
+class TransformSystem {
+  public:
+    static constexpr int NO_PARENT = -1;
+
+    void Reserve(size_t count) {
+        size_t padded = RoundUp(count);
+        for (FloatArray *array : FloatArrays()) {
+            array->reserve(padded);
+        }
+        parents.reserve(padded);
+        localDirty.reserve(padded);
+        worldDirty.reserve(padded);
+        localMatrices.reserve(padded);
+        worldMatrices.reserve(padded);
+    }
+
+    // Adds an entity and returns its index. The parent must already exist.
+    int Create(const glm::vec3 &position = glm::vec3(0.0f),
+               const glm::quat &rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+               const glm::vec3 &scale = glm::vec3(1.0f), int parent = NO_PARENT) {
+        assert(parent < static_cast<int>(count) && "parents must be created before their children");
+
+        if (count == parents.size()) {
+            Grow();
+        }
+        int entity = static_cast<int>(count++);
+        parents[entity] = parent;
+        SetPosition(entity, position);
+        SetRotation(entity, rotation);
+        SetScale(entity, scale);
+        return entity;
+    }
+
+    size_t Size() const { return count; }
+    int Parent(int entity) const { return parents[entity]; }
+
+    void SetPosition(int entity, const glm::vec3 &position) {
+        px[entity] = position.x;
+        py[entity] = position.y;
+        pz[entity] = position.z;
+        MarkDirty(entity);
+    }
+
+    void SetRotation(int entity, const glm::quat &rotation) {
+        qx[entity] = rotation.x;
+        qy[entity] = rotation.y;
+        qz[entity] = rotation.z;
+        qw[entity] = rotation.w;
+        MarkDirty(entity);
+    }
+
+    void SetScale(int entity, const glm::vec3 &scale) {
+        sx[entity] = scale.x;
+        sy[entity] = scale.y;
+        sz[entity] = scale.z;
+        MarkDirty(entity);
+    }
+
+    glm::vec3 GetPosition(int entity) const { return glm::vec3(px[entity], py[entity], pz[entity]); }
+    glm::quat GetRotation(int entity) const { return glm::quat(qw[entity], qx[entity], qy[entity], qz[entity]); }
+    glm::vec3 GetScale(int entity) const { return glm::vec3(sx[entity], sy[entity], sz[entity]); }
+
+    // valid after Update()
+    const glm::mat4 &LocalMatrix(int entity) const { return localMatrices[entity]; }
+    const glm::mat4 &WorldMatrix(int entity) const { return worldMatrices[entity]; }
+    const glm::mat4 *WorldMatrices() const { return worldMatrices.data(); }
+
+    // Recomposes the local matrices of changed entities, then the world
+    // matrices of changed entities and all of their descendants.
+    void Update() {
+        if (firstDirty >= count) {
+            return;
+        }
+
+        ComposeLocalMatrices();
+        ComposeWorldMatrices();
+
+        std::memset(&localDirty[firstDirty], 0, parents.size() - firstDirty);
+        firstDirty = SIZE_MAX;
+    }
+
+  private:
+    using FloatArray = std::vector<float, AlignedAllocator<float, 32>>;
+    using MatrixArray = std::vector<glm::mat4, AlignedAllocator<glm::mat4, 32>>;
+
+    // every array is padded to a multiple of this, so the widest kernel can
+    // always load and store whole blocks
+    static constexpr size_t BLOCK = 8;
+
+    static size_t RoundUp(size_t value) { return (value + BLOCK - 1) / BLOCK * BLOCK; }
+
+    std::vector<FloatArray *> FloatArrays() {
+        return {&px, &py, &pz, &qx, &qy, &qz, &qw, &sx, &sy, &sz};
+    }
+
+    // padding entities are identity transforms so the kernels stay finite
+    void Grow() {
+        size_t size = parents.size() + BLOCK;
+        for (FloatArray *array : {&px, &py, &pz, &qx, &qy, &qz}) {
+            array->resize(size, 0.0f);
+        }
+        for (FloatArray *array : {&qw, &sx, &sy, &sz}) {
+            array->resize(size, 1.0f);
+        }
+        parents.resize(size, NO_PARENT);
+        localDirty.resize(size, 0);
+        worldDirty.resize(size, 0);
+        localMatrices.resize(size, glm::mat4(1.0f));
+        worldMatrices.resize(size, glm::mat4(1.0f));
+    }
+
+    void MarkDirty(int entity) {
+        localDirty[entity] = 1;
+        if (static_cast<size_t>(entity) < firstDirty) {
+            firstDirty = entity;
+        }
+    }
+
+    bool BlockDirty(size_t begin, size_t width) const {
+        for (size_t i = begin; i < begin + width; ++i) {
+            if (localDirty[i]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ComposeLocalMatrices() {
+#if defined(__AVX__)
+        ComposeLocalMatricesSimd<Avx>();
+#elif defined(TRANSFORM_SYSTEM_SSE)
+        ComposeLocalMatricesSimd<Sse>();
+#else
+        for (size_t i = firstDirty; i < count; ++i) {
+            if (localDirty[i]) {
+                glm::mat4 rotation = glm::mat4_cast(GetRotation(int(i)));
+                glm::vec3 scale = GetScale(int(i));
+                localMatrices[i] = rotation;
+                localMatrices[i][0] *= scale.x;
+                localMatrices[i][1] *= scale.y;
+                localMatrices[i][2] *= scale.z;
+                localMatrices[i][3] = glm::vec4(GetPosition(int(i)), 1.0f);
+            }
+        }
+#endif
+    }
+
+    // world = parentWorld * local, propagating dirtiness down the hierarchy
+    void ComposeWorldMatrices() {
+        for (size_t i = firstDirty; i < count; ++i) {
+            int parent = parents[i];
+            bool dirty = localDirty[i] || (parent != NO_PARENT && worldDirty[parent]);
+            worldDirty[i] = dirty;
+            if (!dirty) {
+                continue;
+            }
+            if (parent == NO_PARENT) {
+                worldMatrices[i] = localMatrices[i];
+            } else {
+                Multiply(worldMatrices[parent], localMatrices[i], worldMatrices[i]);
+            }
+        }
+        std::memset(&worldDirty[firstDirty], 0, parents.size() - firstDirty);
+    }
+
+#if defined(TRANSFORM_SYSTEM_SSE)
+    struct Sse {
+        using V = __m128;
+        static constexpr size_t WIDTH = 4;
+        static V Load(const float *p) { return _mm_load_ps(p); }
+        static V Set(float value) { return _mm_set1_ps(value); }
+        static V Add(V a, V b) { return _mm_add_ps(a, b); }
+        static V Sub(V a, V b) { return _mm_sub_ps(a, b); }
+        static V Mul(V a, V b) { return _mm_mul_ps(a, b); }
+
+        // x, y, z, w hold one component of column `column` for each lane;
+        // transpose them into one column per entity
+        static void StoreColumn(glm::mat4 *out, int column, V x, V y, V z, V w) {
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            _mm_storeu_ps(&out[0][column][0], x);
+            _mm_storeu_ps(&out[1][column][0], y);
+            _mm_storeu_ps(&out[2][column][0], z);
+            _mm_storeu_ps(&out[3][column][0], w);
+        }
+    };
+#endif
+
+#if defined(__AVX__)
+    struct Avx {
+        using V = __m256;
+        static constexpr size_t WIDTH = 8;
+        static V Load(const float *p) { return _mm256_load_ps(p); }
+        static V Set(float value) { return _mm256_set1_ps(value); }
+        static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+        static V Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+        static V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+
+        static void StoreColumn(glm::mat4 *out, int column, V x, V y, V z, V w) {
+            Sse::StoreColumn(out, column, _mm256_castps256_ps128(x), _mm256_castps256_ps128(y),
+                             _mm256_castps256_ps128(z), _mm256_castps256_ps128(w));
+            Sse::StoreColumn(out + 4, column, _mm256_extractf128_ps(x, 1), _mm256_extractf128_ps(y, 1),
+                             _mm256_extractf128_ps(z, 1), _mm256_extractf128_ps(w, 1));
+        }
+    };
+#endif
+
+#if defined(TRANSFORM_SYSTEM_SSE)
+    // local = T * R * S for S::WIDTH entities per iteration. Blocks without
+    // any changed entity are skipped; clean lanes of a dirty block are
+    // recomposed from unchanged inputs, which leaves them as they were.
+    template <typename S> void ComposeLocalMatricesSimd() {
+        using V = typename S::V;
+        const V one = S::Set(1.0f);
+        const V two = S::Set(2.0f);
+        const V zero = S::Set(0.0f);
+
+        for (size_t i = firstDirty / S::WIDTH * S::WIDTH; i < count; i += S::WIDTH) {
+            if (!BlockDirty(i, S::WIDTH)) {
+                continue;
+            }
+
+            V x = S::Load(&qx[i]), y = S::Load(&qy[i]), z = S::Load(&qz[i]), w = S::Load(&qw[i]);
+            V xx = S::Mul(x, x), yy = S::Mul(y, y), zz = S::Mul(z, z);
+            V xy = S::Mul(x, y), xz = S::Mul(x, z), yz = S::Mul(y, z);
+            V wx = S::Mul(w, x), wy = S::Mul(w, y), wz = S::Mul(w, z);
+
+            V scaleX = S::Load(&sx[i]), scaleY = S::Load(&sy[i]), scaleZ = S::Load(&sz[i]);
+            glm::mat4 *out = &localMatrices[i];
+
+            S::StoreColumn(out, 0,
+                           S::Mul(S::Sub(one, S::Mul(two, S::Add(yy, zz))), scaleX),
+                           S::Mul(S::Mul(two, S::Add(xy, wz)), scaleX),
+                           S::Mul(S::Mul(two, S::Sub(xz, wy)), scaleX), zero);
+            S::StoreColumn(out, 1,
+                           S::Mul(S::Mul(two, S::Sub(xy, wz)), scaleY),
+                           S::Mul(S::Sub(one, S::Mul(two, S::Add(xx, zz))), scaleY),
+                           S::Mul(S::Mul(two, S::Add(yz, wx)), scaleY), zero);
+            S::StoreColumn(out, 2,
+                           S::Mul(S::Mul(two, S::Add(xz, wy)), scaleZ),
+                           S::Mul(S::Mul(two, S::Sub(yz, wx)), scaleZ),
+                           S::Mul(S::Sub(one, S::Mul(two, S::Add(xx, yy))), scaleZ), zero);
+            S::StoreColumn(out, 3, S::Load(&px[i]), S::Load(&py[i]), S::Load(&pz[i]), one);
+        }
+    }
+#endif
+
+    static void Multiply(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out) {
+#if defined(TRANSFORM_SYSTEM_SSE)
+        __m128 a0 = _mm_loadu_ps(&a[0][0]);
+        __m128 a1 = _mm_loadu_ps(&a[1][0]);
+        __m128 a2 = _mm_loadu_ps(&a[2][0]);
+        __m128 a3 = _mm_loadu_ps(&a[3][0]);
+        for (int j = 0; j < 4; ++j) {
+            __m128 column = _mm_mul_ps(a0, _mm_set1_ps(b[j][0]));
+            column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(b[j][1])));
+            column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(b[j][2])));
+            column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(b[j][3])));
+            _mm_storeu_ps(&out[j][0], column);
+        }
+#else
+        out = a * b;
+#endif
+    }
+
+    size_t count = 0;
+    size_t firstDirty = SIZE_MAX;
+
+    FloatArray px, py, pz;
+    FloatArray qx, qy, qz, qw;
+    FloatArray sx, sy, sz;
+    std::vector<int32_t> parents;
+    std::vector<uint8_t> localDirty;
+    std::vector<uint8_t> worldDirty;
+    MatrixArray localMatrices;
+    MatrixArray worldMatrices;
+};
+
+#endif // TRANSFORM_SYSTEM_HPP
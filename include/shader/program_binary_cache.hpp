@@ -0,0 +1,163 @@
+#ifndef PROGRAM_BINARY_CACHE_HPP
+#define PROGRAM_BINARY_CACHE_HPP
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// Persistent cache of linked program binaries (glGetProgramBinary /
+// glProgramBinary). Entries are keyed by a hash of the shader sources and of
+// the GL vendor/renderer/version strings, so a driver update or a source
+// edit simply misses the cache and the caller falls back to compiling.
+class ProgramBinaryCache {
+  public:
+    explicit ProgramBinaryCache(const std::string &directory = ".shader_cache")
+        : directory(directory) {}
+
+    // the driver must expose at least one binary format for the cache to work
+    static bool IsSupported() {
+        int formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+
+    // Builds the cache key for a program. Must be called with a current context.
+    std::string MakeKey(const std::string &vertexCode,
+                        const std::string &fragmentCode) const {
+        uint64_t hash = FNV_OFFSET;
+        hash = HashString(hash, vertexCode);
+        hash = HashString(hash, fragmentCode);
+        hash = HashString(hash, GetGLString(GL_VENDOR));
+        hash = HashString(hash, GetGLString(GL_RENDERER));
+        hash = HashString(hash, GetGLString(GL_VERSION));
+
+        char key[17];
+        std::snprintf(key, sizeof(key), "%016llx", (unsigned long long)hash);
+        return key;
+    }
+
+    // Loads the cached binary into the program. Returns false when there is
+    // no entry, when it is malformed, or when the driver rejects it.
+    bool Load(unsigned int program, const std::string &key) const {
+        std::ifstream file(EntryPath(key), std::ios::binary);
+        if (!file) {
+            return false;
+        }
+
+        Header header;
+        if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+            header.magic != MAGIC || header.version != VERSION ||
+            header.length == 0) {
+            return false;
+        }
+
+        // the binary is the rest of the file; a corrupt length must not
+        // allocate more than is there
+        std::streampos dataStart = file.tellg();
+        file.seekg(0, std::ios::end);
+        std::streamoff remaining = file.tellg() - dataStart;
+        if (remaining < 0 || uint64_t(header.length) > uint64_t(remaining)) {
+            return false;
+        }
+        file.seekg(dataStart);
+
+        std::vector<char> binary(header.length);
+        if (!file.read(binary.data(), binary.size())) {
+            return false;
+        }
+
+        glProgramBinary(program, header.format, binary.data(),
+                        static_cast<GLsizei>(binary.size()));
+
+        int success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        return success != 0;
+    }
+
+    // Writes the binary of a successfully linked program. The program should
+    // have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+    void Store(unsigned int program, const std::string &key) const {
+        int length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) {
+            return;
+        }
+
+        Header header;
+        std::vector<char> binary(length);
+        GLsizei written = 0;
+        glGetProgramBinary(program, length, &written, &header.format,
+                           binary.data());
+        if (written <= 0) {
+            return;
+        }
+        header.length = static_cast<uint32_t>(written);
+
+        std::error_code ec;
+        std::filesystem::create_directories(directory, ec);
+        if (ec) {
+            std::cerr << "ERROR::PROGRAM_BINARY_CACHE::CANNOT_CREATE_DIRECTORY "
+                      << directory << std::endl;
+            return;
+        }
+
+        // Write to a temporary file first so a crash never leaves a torn entry
+        std::filesystem::path path = EntryPath(key);
+        std::filesystem::path tmpPath = path;
+        tmpPath += ".tmp";
+        {
+            std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            file.write(binary.data(), written);
+            if (!file) {
+                return;
+            }
+        }
+        std::filesystem::rename(tmpPath, path, ec);
+    }
+
+  private:
+    static constexpr uint32_t MAGIC = 0x42504c47; // "GLPB"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+    static constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+    struct Header {
+        uint32_t magic = MAGIC;
+        uint32_t version = VERSION;
+        GLenum format = 0;
+        uint32_t length = 0;
+    };
+
+    std::filesystem::path directory;
+
+    std::filesystem::path EntryPath(const std::string &key) const {
+        return directory / (key + ".bin");
+    }
+
+    // FNV-1a; the length is mixed in so that adjacent strings cannot alias
+    static uint64_t HashString(uint64_t hash, const std::string &value) {
+        for (unsigned char c : value) {
+            hash = (hash ^ c) * FNV_PRIME;
+        }
+        uint64_t length = value.size();
+        for (int i = 0; i < 8; ++i) {
+            hash = (hash ^ ((length >> (8 * i)) & 0xff)) * FNV_PRIME;
+        }
+        return hash;
+    }
+
+    static std::string GetGLString(GLenum name) {
+        const GLubyte *value = glGetString(name);
+        return value ? reinterpret_cast<const char *>(value) : "";
+    }
+};
+
+#endif // PROGRAM_BINARY_CACHE_HPP
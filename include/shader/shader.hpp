@@ -7,15 +7,103 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <unordered_map>
+
+#include "program_binary_cache.hpp"
+#include "renderer/gl_state_cache.hpp"
+
+// Vertex and fragment source code of a program, e.g. read ahead of time by
+// the asset streamer
+struct ShaderSources {
+    std::string vertex;
+    std::string fragment;
+};
 
 class Shader {
   public:
     unsigned int ID;
 
-    Shader(const char *vertexPath, const char *fragmentPath) {
-        // 1. Retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
+    // When a binary cache is given, a previously linked binary of the same
+    // sources is loaded instead of compiling, and fresh links are stored.
+    Shader(const char *vertexPath, const char *fragmentPath,
+           const ProgramBinaryCache *binaryCache = nullptr)
+        : Shader(readSources(vertexPath, fragmentPath), binaryCache) {}
+
+    explicit Shader(const ShaderSources &sources,
+                    const ProgramBinaryCache *binaryCache = nullptr)
+        : binaryCache(binaryCache) {
+        // 1. Try the program binary cache first; fall back to compiling from
+        // source when the entry is missing, stale or rejected by the driver
+        ProgramBuild build = startBuild(sources);
+
+        // 2. Wait for the compile and link to finish
+        finishBuild(build);
+        ID = build.program;
+
+        // 3. Resolve every active uniform location once, up front
+        cacheUniformLocations();
+    }
+
+    ~Shader() {
+        cancelReload();
+        GLStateCache::Get().DeleteProgram(ID);
+    }
+
+    Shader(const Shader &) = delete;
+    Shader &operator=(const Shader &) = delete;
+
+    // Lets the driver compile on as many threads as it likes, so that
+    // reloads can be polled instead of blocking. Call once per context.
+    static void enableParallelCompile() {
+#ifdef GL_KHR_parallel_shader_compile
+        if (GLAD_GL_KHR_parallel_shader_compile) {
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        }
+#endif
+    }
+
+    enum class ReloadStatus { None, Pending, Swapped, Failed };
+
+    // Starts building a new program from the given sources. The current
+    // program stays in use until pollReload() reports it was swapped.
+    void beginReload(const ShaderSources &sources) {
+        cancelReload();
+        reload = startBuild(sources);
+    }
+
+    // Call once per frame while a reload is in flight. On success the new
+    // program replaces ID, and the uniform cache and block bindings are
+    // rebuilt; uniform values (e.g. sampler units) must be set again.
+    ReloadStatus pollReload() {
+        if (reload.program == 0) {
+            return ReloadStatus::None;
+        }
+        if (!isBuildComplete(reload)) {
+            return ReloadStatus::Pending;
+        }
+
+        if (!finishBuild(reload)) {
+            glDeleteProgram(reload.program);
+            reload = ProgramBuild();
+            return ReloadStatus::Failed;
+        }
+
+        GLStateCache::Get().DeleteProgram(ID);
+        ID = reload.program;
+        reload = ProgramBuild();
+        cacheUniformLocations();
+        for (const auto &[name, binding] : blockBindings) {
+            bindUniformBlock(name, binding);
+        }
+        return ReloadStatus::Swapped;
+    }
+
+    // Activate the shader; does nothing if it is active already
+    void use() { GLStateCache::Get().UseProgram(ID); }
+
+    // Reads both source files; needs no GL context, so it can run on any thread
+    static ShaderSources readSources(const char *vertexPath, const char *fragmentPath) {
+        ShaderSources sources;
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
 
@@ -38,78 +126,218 @@ class Shader {
             fShaderFile.close();
 
             // Convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            sources.vertex = vShaderStream.str();
+            sources.fragment = fShaderStream.str();
         } catch (std::ifstream::failure &e) {
             std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ"
                       << std::endl;
         }
+        return sources;
+    }
 
-        const char *vShaderCode = vertexCode.c_str();
-        const char *fShaderCode = fragmentCode.c_str();
-
-        // 2. Compile shaders
-        unsigned int vertex, fragment;
-        int success;
-        char infoLog[512];
-
-        // Vertex Shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-
-        // Fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-
-        // Shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-
-        // Delete the shaders as they're linked into our program now and no
-        // longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+    // Returns the location resolved at link time, or -1 if the program has
+    // no such active uniform. Look it up once and keep the handle around.
+    int getUniformLocation(const std::string &name) const {
+        auto it = uniformLocations.find(name);
+        return it != uniformLocations.end() ? it->second : -1;
     }
 
-    // Activate the shader
-    void use() { glUseProgram(ID); }
+    // Binds the named uniform block to a binding point shared by programs.
+    // The binding is remembered and applied again after a reload.
+    void bindUniformBlock(const std::string &name, unsigned int binding) {
+        blockBindings[name] = binding;
+        unsigned int index = glGetUniformBlockIndex(ID, name.c_str());
+        if (index != GL_INVALID_INDEX) {
+            glUniformBlockBinding(ID, index, binding);
+        }
+    }
 
-    // Utility uniform functions
+    // Utility uniform functions, by name
     void setBool(const std::string &name, bool value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        setBool(getUniformLocation(name), value);
     }
 
     void setInt(const std::string &name, int value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        setInt(getUniformLocation(name), value);
     }
 
     void setFloat(const std::string &name, float value) const {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        setFloat(getUniformLocation(name), value);
     }
 
     void setVec2(const std::string &name, const glm::vec2 &value) const {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec2(getUniformLocation(name), value);
     }
 
     void setVec3(const std::string &name, const glm::vec3 &value) const {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec3(getUniformLocation(name), value);
     }
 
     void setMat4(const std::string &name, const glm::mat4 &mat) const {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
-                           &mat[0][0]);
+        setMat4(getUniformLocation(name), mat);
+    }
+
+    // Utility uniform functions, by location handle
+    void setBool(int location, bool value) const {
+        glUniform1i(location, (int)value);
+    }
+
+    void setInt(int location, int value) const { glUniform1i(location, value); }
+
+    void setFloat(int location, float value) const {
+        glUniform1f(location, value);
+    }
+
+    void setVec2(int location, const glm::vec2 &value) const {
+        glUniform2fv(location, 1, &value[0]);
+    }
+
+    void setVec3(int location, const glm::vec3 &value) const {
+        glUniform3fv(location, 1, &value[0]);
+    }
+
+    void setMat4(int location, const glm::mat4 &mat) const {
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
     }
 
   private:
+    // A program whose compile and link were issued but maybe not finished
+    struct ProgramBuild {
+        unsigned int program = 0;
+        unsigned int vertex = 0;
+        unsigned int fragment = 0;
+        // set when the program came from the binary cache, i.e. is already linked
+        bool fromCache = false;
+        std::string cacheKey;
+    };
+
+    const ProgramBinaryCache *binaryCache;
+    std::unordered_map<std::string, int> uniformLocations;
+    std::unordered_map<std::string, unsigned int> blockBindings;
+    ProgramBuild reload;
+
+    // Issues the compile and link without waiting for either, or loads the
+    // program from the binary cache when it has these sources
+    ProgramBuild startBuild(const ShaderSources &sources) const {
+        ProgramBuild build;
+        if (binaryCache && ProgramBinaryCache::IsSupported()) {
+            build.cacheKey = binaryCache->MakeKey(sources.vertex, sources.fragment);
+            build.program = glCreateProgram();
+            if (binaryCache->Load(build.program, build.cacheKey)) {
+                build.fromCache = true;
+                return build;
+            }
+            glDeleteProgram(build.program);
+        }
+
+        const char *vShaderCode = sources.vertex.c_str();
+        const char *fShaderCode = sources.fragment.c_str();
+
+        // Vertex Shader
+        build.vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(build.vertex, 1, &vShaderCode, NULL);
+        glCompileShader(build.vertex);
+
+        // Fragment Shader
+        build.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(build.fragment, 1, &fShaderCode, NULL);
+        glCompileShader(build.fragment);
+
+        // Shader Program
+        build.program = glCreateProgram();
+        glAttachShader(build.program, build.vertex);
+        glAttachShader(build.program, build.fragment);
+        if (!build.cacheKey.empty()) {
+            glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(build.program);
+        return build;
+    }
+
+    // Without parallel compile support the status queries below block until
+    // the driver is done, so a build is always reported complete
+    static bool isBuildComplete(const ProgramBuild &build) {
+#ifdef GL_KHR_parallel_shader_compile
+        if (GLAD_GL_KHR_parallel_shader_compile && !build.fromCache) {
+            int complete = 0;
+            glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &complete);
+            return complete != 0;
+        }
+#endif
+        return true;
+    }
+
+    // Reports compile/link errors, releases the shader objects and stores
+    // fresh links in the binary cache. Returns whether the program linked.
+    bool finishBuild(ProgramBuild &build) const {
+        if (build.fromCache) {
+            return true;
+        }
+
+        checkCompileErrors(build.vertex, "VERTEX");
+        checkCompileErrors(build.fragment, "FRAGMENT");
+        checkCompileErrors(build.program, "PROGRAM");
+
+        // Delete the shaders as they're linked into our program now and no
+        // longer necessary
+        glDeleteShader(build.vertex);
+        glDeleteShader(build.fragment);
+        build.vertex = build.fragment = 0;
+
+        int linked = 0;
+        glGetProgramiv(build.program, GL_LINK_STATUS, &linked);
+        if (linked && !build.cacheKey.empty()) {
+            binaryCache->Store(build.program, build.cacheKey);
+        }
+        return linked != 0;
+    }
+
+    void cancelReload() {
+        if (reload.program == 0) {
+            return;
+        }
+        glDeleteShader(reload.vertex);
+        glDeleteShader(reload.fragment);
+        glDeleteProgram(reload.program);
+        reload = ProgramBuild();
+    }
+
+    // Queries every active uniform of the linked program. Uniforms living in
+    // blocks have no location and are left out.
+    void cacheUniformLocations() {
+        uniformLocations.clear();
+
+        int count = 0;
+        int maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::string name(maxLength, '\0');
+        for (int i = 0; i < count; ++i) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, i, maxLength, &length, &size, &type,
+                               name.data());
+
+            std::string uniformName = name.substr(0, length);
+            int location = glGetUniformLocation(ID, uniformName.c_str());
+            if (location < 0) {
+                continue;
+            }
+
+            // Arrays are reported as "name[0]"; make them reachable by "name"
+            uniformLocations[uniformName] = location;
+            if (uniformName.size() > 3 &&
+                uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0) {
+                uniformLocations[uniformName.substr(0, uniformName.size() - 3)] =
+                    location;
+            }
+        }
+    }
+
     // Utility function for checking shader compilation/linking errors.
-    void checkCompileErrors(unsigned int shader, std::string type) {
+    static void checkCompileErrors(unsigned int shader, std::string type) {
         int success;
         char infoLog[1024];
         if (type != "PROGRAM") {
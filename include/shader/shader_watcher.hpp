@@ -0,0 +1,94 @@
+#ifndef SHADER_WATCHER_HPP
+#define SHADER_WATCHER_HPP
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Reports changes to shader source files through inotify, without ever
+// blocking. Directories are watched rather than the files themselves,
+// because many editors save by writing a new file and renaming it over the
+// old one, which would silently end a watch on the file. On platforms
+// without inotify the watcher never reports anything.
+class ShaderWatcher {
+  public:
+    ShaderWatcher() {
+#ifdef __linux__
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    }
+
+    ~ShaderWatcher() {
+#ifdef __linux__
+        if (fd >= 0) {
+            close(fd);
+        }
+#endif
+    }
+
+    ShaderWatcher(const ShaderWatcher &) = delete;
+    ShaderWatcher &operator=(const ShaderWatcher &) = delete;
+
+    bool IsEnabled() const { return fd >= 0; }
+
+    void Watch(const std::string &path) {
+#ifdef __linux__
+        if (fd < 0) {
+            return;
+        }
+        size_t slash = path.find_last_of('/');
+        std::string directory = slash == std::string::npos ? "." : path.substr(0, slash);
+        std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+        // Adding the same directory twice returns the existing descriptor
+        int wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd >= 0) {
+            watchedFiles[wd][name] = path;
+        }
+#endif
+    }
+
+    // Appends every watched file written since the last call to changed,
+    // each once, under the path it was registered with
+    void Poll(std::vector<std::string> &changed) {
+#ifdef __linux__
+        if (fd < 0) {
+            return;
+        }
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+            for (ssize_t offset = 0; offset < length;) {
+                const inotify_event *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+                if (event->len == 0) {
+                    continue;
+                }
+
+                auto directory = watchedFiles.find(event->wd);
+                if (directory == watchedFiles.end()) {
+                    continue;
+                }
+                auto file = directory->second.find(event->name);
+                if (file != directory->second.end() &&
+                    std::find(changed.begin(), changed.end(), file->second) == changed.end()) {
+                    changed.push_back(file->second);
+                }
+            }
+        }
+#endif
+    }
+
+  private:
+    int fd = -1;
+    // watch descriptor -> file name within that directory -> registered path
+    std::unordered_map<int, std::unordered_map<std::string, std::string>> watchedFiles;
+};
+
+#endif // SHADER_WATCHER_HPP
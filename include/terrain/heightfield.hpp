@@ -0,0 +1,93 @@
+#ifndef HEIGHTFIELD_HPP
+#define HEIGHTFIELD_HPP
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+
+// Procedural ground height, defined everywhere so terrain can be generated
+// around the camera wherever it goes. The ground is flat around the origin,
+// where the cubes are dropped onto the physics ground plane, and turns into
+// fractal value-noise hills further out. Only reads its parameters, so any
+// thread may sample it.
+class Heightfield {
+  public:
+    static constexpr float GROUND_HEIGHT = -0.5f;
+    static constexpr float HILL_HEIGHT = 24.0f;
+    // radius of the flat area, and the distance over which hills rise
+    static constexpr float FLAT_RADIUS = 60.0f;
+    static constexpr float BLEND_DISTANCE = 40.0f;
+    // size of the largest hills
+    static constexpr float FEATURE_SIZE = 96.0f;
+    static constexpr int OCTAVES = 5;
+
+    explicit Heightfield(uint32_t seed = 1) : seed(seed) {}
+
+    static constexpr float MinHeight() { return GROUND_HEIGHT; }
+    static constexpr float MaxHeight() { return GROUND_HEIGHT + HILL_HEIGHT; }
+
+    float Height(float x, float z) const {
+        float distance = std::sqrt(x * x + z * z);
+        float t = glm::clamp((distance - FLAT_RADIUS) / BLEND_DISTANCE, 0.0f, 1.0f);
+        float hills = t * t * (3.0f - 2.0f * t);
+        if (hills == 0.0f) {
+            return GROUND_HEIGHT;
+        }
+
+        // fractal sum of octaves, normalized to [-1, 1]
+        float sum = 0.0f, amplitude = 1.0f, total = 0.0f;
+        float frequency = 1.0f / FEATURE_SIZE;
+        for (int octave = 0; octave < OCTAVES; octave++) {
+            sum += amplitude * ValueNoise(x * frequency, z * frequency, uint32_t(octave));
+            total += amplitude;
+            amplitude *= 0.5f;
+            frequency *= 2.0f;
+        }
+        return GROUND_HEIGHT + hills * HILL_HEIGHT * (0.5f + 0.5f * sum / total);
+    }
+
+    // Surface normal by central differences over step
+    glm::vec3 Normal(float x, float z, float step) const {
+        float dx = Height(x + step, z) - Height(x - step, z);
+        float dz = Height(x, z + step) - Height(x, z - step);
+        return glm::normalize(glm::vec3(-dx, 2.0f * step, -dz));
+    }
+
+    // Pale ground on the flats, grass on gentle slopes, rock on steep ones
+    static glm::vec3 Color(float height, const glm::vec3 &normal) {
+        const glm::vec3 ground(0.8f), grass(0.42f, 0.56f, 0.32f), rock(0.5f, 0.46f, 0.42f);
+        float rise = glm::clamp((height - GROUND_HEIGHT) / 2.0f, 0.0f, 1.0f);
+        float steep = glm::clamp((0.9f - normal.y) * 4.0f, 0.0f, 1.0f);
+        return glm::mix(glm::mix(ground, grass, rise), rock, steep * rise);
+    }
+
+  private:
+    // Random value in [-1, 1] at a lattice point
+    float Lattice(int32_t x, int32_t z, uint32_t octave) const {
+        uint32_t h = seed ^ (uint32_t(x) * 0x8da6b343u) ^ (uint32_t(z) * 0xd8163841u) ^ (octave * 0xcb1ab31fu);
+        h ^= h >> 15;
+        h *= 0x2c1b3c6du;
+        h ^= h >> 12;
+        h *= 0x297a2d39u;
+        h ^= h >> 15;
+        return float(h & 0xffffffu) / float(0xffffff) * 2.0f - 1.0f;
+    }
+
+    // Smoothly interpolated lattice values
+    float ValueNoise(float x, float z, uint32_t octave) const {
+        float fx = std::floor(x), fz = std::floor(z);
+        int32_t ix = int32_t(fx), iz = int32_t(fz);
+        float tx = x - fx, tz = z - fz;
+        tx = tx * tx * (3.0f - 2.0f * tx);
+        tz = tz * tz * (3.0f - 2.0f * tz);
+
+        float a = Lattice(ix, iz, octave), b = Lattice(ix + 1, iz, octave);
+        float c = Lattice(ix, iz + 1, octave), d = Lattice(ix + 1, iz + 1, octave);
+        return glm::mix(glm::mix(a, b, tx), glm::mix(c, d, tx), tz);
+    }
+
+    uint32_t seed;
+};
+
+#endif // HEIGHTFIELD_HPP
@@ -0,0 +1,527 @@
+#ifndef TERRAIN_HPP
+#define TERRAIN_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "concurrency/bounded_queue.hpp"
+#include "heightfield.hpp"
+#include "profiler/profiler.hpp"
+#include "renderer/geometry_arena.hpp"
+#include "scene/frustum.hpp"
+
+// Heightfield ground made of square chunks, kept resident only around the
+// camera. Chunks are meshed on a generator thread and uploaded into the
+// geometry arena on the GL thread; chunks that fall out of range give their
+// vertices back to the arena.
+//
+// Detail drops with the chunk's ring distance from the camera's chunk: LOD
+// n has CHUNK_QUADS >> n quads per side. Every LOD's index grid is the same
+// for all chunks, so it is uploaded once and shared. Seams are closed on the
+// vertex side instead: along an edge shared with a coarser chunk, the
+// vertices the coarse chunk lacks are moved onto its edge, so both sides
+// meet exactly.
+//
+// Every chunk also carries a coarse occluder mesh for software occlusion
+// culling, built alongside it and shown with it.
+//
+// Chunks change LOD together. New meshes are staged and replace the shown
+// ones only once every chunk of the new layout is ready, so neighbours that
+// were stitched for each other always appear together.
+class Terrain {
+  public:
+    static constexpr float CHUNK_SIZE = 32.0f;
+    static constexpr uint32_t CHUNK_QUADS = 32; // per side, at LOD 0
+    static constexpr uint32_t LOD_COUNT = 3;
+    // chunks kept in every direction around the camera's chunk
+    static constexpr int VIEW_RADIUS = 7;
+    static constexpr size_t BUILT_QUEUE_CAPACITY = 16;
+    // quads per side of a chunk's occluder, and the rings around the
+    // camera's chunk that offer theirs
+    static constexpr uint32_t OCCLUDER_QUADS = 8;
+    static constexpr int OCCLUDER_RADIUS = 3;
+
+    Terrain() : built(BUILT_QUEUE_CAPACITY), occluderIndices(GridIndices(OCCLUDER_QUADS)) {}
+    ~Terrain() { Stop(); }
+
+    Terrain(const Terrain &) = delete;
+    Terrain &operator=(const Terrain &) = delete;
+
+    // GL thread: uploads the shared index grids and starts the generator
+    void Start(GeometryArena *geometry) {
+        if (generator.joinable()) {
+            return;
+        }
+        arena = geometry;
+        layout = geometry->Layout();
+        for (uint32_t lod = 0; lod < LOD_COUNT; lod++) {
+            std::vector<uint32_t> indices = GridIndices(QuadsPerSide(lod));
+            lodIndices[lod] = ArenaMesh();
+            lodIndices[lod].firstIndex = arena->AllocateIndices(uint32_t(indices.size()));
+            lodIndices[lod].indexCount = uint32_t(indices.size());
+            arena->UploadIndices(lodIndices[lod], 0, indices.data(), uint32_t(indices.size()));
+        }
+
+        stopping = false;
+        generator = std::thread(&Terrain::GeneratorMain, this);
+    }
+
+    // Must run before the GL context goes away
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(requestsMutex);
+            stopping = true;
+        }
+        requestsReady.notify_all();
+        built.Close();
+        if (generator.joinable()) {
+            generator.join();
+        }
+        chunks.clear();
+        pending = 0;
+        planned = false;
+    }
+
+    // GL thread: plans the chunks around eye, then uploads finished chunks
+    // until the budget is spent
+    void Update(const glm::vec3 &eye, double budgetSeconds) {
+        Plan(eye);
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(budgetSeconds);
+        BuiltChunk chunk;
+        while (pending > 0 && built.TryPop(chunk)) {
+            Accept(chunk);
+            if (std::chrono::steady_clock::now() >= deadline) {
+                break;
+            }
+        }
+        SwapIfReady();
+    }
+
+    // GL thread: blocks until the chunks planned by the last Update() show
+    void Flush() {
+        BuiltChunk chunk;
+        while (pending > 0 && built.Pop(chunk)) {
+            Accept(chunk);
+        }
+        SwapIfReady();
+    }
+
+    // Appends the shown chunks intersecting the frustum
+    void Cull(const Frustum &frustum, std::vector<const ArenaMesh *> &visible) const {
+        for (const auto &entry : chunks) {
+            const Chunk &chunk = entry.second;
+            if (chunk.hasShown && frustum.IsVisible(chunk.shown.Bounds)) {
+                visible.push_back(&chunk.shown);
+            }
+        }
+    }
+
+    // Appends the occluder vertices of the shown chunks near the camera that
+    // intersect the frustum. Each is a grid of (OCCLUDER_QUADS + 1)^2
+    // vertices triangulated by OccluderIndices(), lying on or below the
+    // chunk's shown mesh.
+    void CullOccluders(const Frustum &frustum, std::vector<const std::vector<glm::vec3> *> &occluders) const {
+        for (const auto &entry : chunks) {
+            const Chunk &chunk = entry.second;
+            int32_t ring = std::max(std::abs(chunk.x - centerX), std::abs(chunk.z - centerZ));
+            if (chunk.hasShown && ring <= OCCLUDER_RADIUS && frustum.IsVisible(chunk.shown.Bounds)) {
+                occluders.push_back(&chunk.shownOccluder);
+            }
+        }
+    }
+
+    const std::vector<uint32_t> &OccluderIndices() const { return occluderIndices; }
+
+  private:
+    // What a chunk's mesh depends on: its LOD and its neighbours', in the
+    // order -X, +X, -Z, +Z
+    struct ChunkShape {
+        uint8_t lod = 0;
+        uint8_t neighbourLods[4] = {};
+
+        bool operator==(const ChunkShape &other) const {
+            return lod == other.lod && std::equal(neighbourLods, neighbourLods + 4, other.neighbourLods);
+        }
+    };
+
+    struct BuildRequest {
+        int32_t x = 0, z = 0;
+        ChunkShape shape;
+    };
+
+    struct BuiltChunk {
+        int32_t x = 0, z = 0;
+        ChunkShape shape;
+        std::vector<uint8_t> vertices;
+        std::vector<glm::vec3> occluder;
+        AABB bounds;
+        glm::vec3 positionOffset, positionScale;
+    };
+
+    struct Chunk {
+        int32_t x = 0, z = 0;
+        bool isWanted = false;
+        ChunkShape wanted;
+        // the mesh being drawn, and the one that replaces it on the next swap
+        bool hasShown = false, hasStaged = false;
+        ChunkShape shownShape, stagedShape;
+        ArenaMesh shown, staged;
+        std::vector<glm::vec3> shownOccluder, stagedOccluder;
+    };
+
+    static uint32_t QuadsPerSide(uint32_t lod) { return CHUNK_QUADS >> lod; }
+    static_assert((CHUNK_QUADS >> (LOD_COUNT - 1)) % OCCLUDER_QUADS == 0, "occluder cells must cover whole quads");
+
+    static uint64_t Key(int32_t x, int32_t z) { return (uint64_t(uint32_t(x)) << 32) | uint32_t(z); }
+
+    static int32_t ChunkCoordinate(float position) { return int32_t(std::floor(position / CHUNK_SIZE)); }
+
+    // Rings 0-1 get LOD 0, rings 2-3 LOD 1, rings 4-7 LOD 2 and so on, so
+    // neighbours differ by at most one level
+    static uint8_t RingLod(int32_t ring) {
+        uint32_t lod = 0;
+        while (ring > 1 && lod + 1 < LOD_COUNT) {
+            ring >>= 1;
+            lod++;
+        }
+        return uint8_t(lod);
+    }
+
+    ChunkShape Shape(int32_t x, int32_t z) const {
+        auto lodAt = [this](int32_t cx, int32_t cz) {
+            return RingLod(std::max(std::abs(cx - centerX), std::abs(cz - centerZ)));
+        };
+        ChunkShape shape;
+        shape.lod = lodAt(x, z);
+        shape.neighbourLods[0] = lodAt(x - 1, z);
+        shape.neighbourLods[1] = lodAt(x + 1, z);
+        shape.neighbourLods[2] = lodAt(x, z - 1);
+        shape.neighbourLods[3] = lodAt(x, z + 1);
+        return shape;
+    }
+
+    static std::vector<uint32_t> GridIndices(uint32_t quads) {
+        std::vector<uint32_t> indices;
+        indices.reserve(size_t(quads) * quads * 6);
+        uint32_t row = quads + 1;
+        for (uint32_t j = 0; j < quads; j++) {
+            for (uint32_t i = 0; i < quads; i++) {
+                uint32_t a = j * row + i, b = a + 1, c = a + row, d = c + 1;
+                // counter-clockwise seen from above
+                indices.insert(indices.end(), {a, c, b, b, c, d});
+            }
+        }
+        return indices;
+    }
+
+    // Re-plans the wanted chunks when the camera enters another chunk
+    void Plan(const glm::vec3 &eye) {
+        int32_t x = ChunkCoordinate(eye.x), z = ChunkCoordinate(eye.z);
+        if (planned && x == centerX && z == centerZ) {
+            return;
+        }
+        PROFILE_ZONE("PlanTerrain");
+        planned = true;
+        centerX = x;
+        centerZ = z;
+
+        for (auto &entry : chunks) {
+            entry.second.isWanted = false;
+        }
+
+        // nearest chunks are generated first
+        std::vector<BuildRequest> builds;
+        for (int32_t ring = 0; ring <= VIEW_RADIUS; ring++) {
+            for (int32_t dz = -ring; dz <= ring; dz++) {
+                for (int32_t dx = -ring; dx <= ring; dx++) {
+                    if (std::max(std::abs(dx), std::abs(dz)) != ring) {
+                        continue;
+                    }
+                    Chunk &chunk = chunks[Key(x + dx, z + dz)];
+                    chunk.x = x + dx;
+                    chunk.z = z + dz;
+                    chunk.isWanted = true;
+                    chunk.wanted = Shape(chunk.x, chunk.z);
+
+                    bool shownFits = chunk.hasShown && chunk.shownShape == chunk.wanted;
+                    bool stagedFits = chunk.hasStaged && chunk.stagedShape == chunk.wanted;
+                    if (chunk.hasStaged && !stagedFits) {
+                        Release(chunk.staged);
+                        chunk.hasStaged = false;
+                    }
+                    if (shownFits && chunk.hasStaged) {
+                        Release(chunk.staged);
+                        chunk.hasStaged = false;
+                    }
+                    if (!shownFits && !stagedFits) {
+                        builds.push_back({chunk.x, chunk.z, chunk.wanted});
+                    }
+                }
+            }
+        }
+
+        // Unwanted chunks keep showing until the swap; what they staged is useless
+        for (auto it = chunks.begin(); it != chunks.end();) {
+            Chunk &chunk = it->second;
+            if (!chunk.isWanted && chunk.hasStaged) {
+                Release(chunk.staged);
+                chunk.hasStaged = false;
+            }
+            if (!chunk.isWanted && !chunk.hasShown) {
+                it = chunks.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        pending = int(builds.size());
+        swapWanted = true;
+        {
+            // Builds still queued for the old plan are dropped; one already
+            // running is discarded when it arrives, unless it still fits
+            std::lock_guard<std::mutex> lock(requestsMutex);
+            requests.assign(builds.begin(), builds.end());
+        }
+        requestsReady.notify_one();
+    }
+
+    // Stages a finished chunk if the current plan still wants it
+    void Accept(BuiltChunk &built) {
+        auto it = chunks.find(Key(built.x, built.z));
+        if (it == chunks.end()) {
+            return;
+        }
+        Chunk &chunk = it->second;
+        if (!chunk.isWanted || !(chunk.wanted == built.shape) || chunk.hasStaged ||
+            (chunk.hasShown && chunk.shownShape == chunk.wanted)) {
+            return;
+        }
+
+        PROFILE_ZONE("UploadChunk");
+        uint32_t lod = built.shape.lod;
+        ArenaMesh mesh = lodIndices[lod];
+        mesh.vertexCount = (QuadsPerSide(lod) + 1) * (QuadsPerSide(lod) + 1);
+        mesh.baseVertex = arena->AllocateVertices(mesh.vertexCount);
+        mesh.Bounds = built.bounds;
+        mesh.positionOffset = built.positionOffset;
+        mesh.positionScale = built.positionScale;
+        arena->UploadVertices(mesh, 0, built.vertices.data(), built.vertices.size());
+
+        chunk.staged = mesh;
+        chunk.stagedOccluder = std::move(built.occluder);
+        chunk.stagedShape = built.shape;
+        chunk.hasStaged = true;
+        pending--;
+    }
+
+    // Shows every staged chunk at once and frees whatever went out of range
+    void SwapIfReady() {
+        if (pending > 0 || !swapWanted) {
+            return;
+        }
+        swapWanted = false;
+        for (auto it = chunks.begin(); it != chunks.end();) {
+            Chunk &chunk = it->second;
+            if (!chunk.isWanted) {
+                Release(chunk.shown);
+                it = chunks.erase(it);
+                continue;
+            }
+            if (chunk.hasStaged) {
+                if (chunk.hasShown) {
+                    Release(chunk.shown);
+                }
+                chunk.shown = chunk.staged;
+                chunk.shownOccluder = std::move(chunk.stagedOccluder);
+                chunk.shownShape = chunk.stagedShape;
+                chunk.hasShown = true;
+                chunk.hasStaged = false;
+            }
+            ++it;
+        }
+    }
+
+    // Index grids are shared, so only the vertices go back to the arena
+    void Release(const ArenaMesh &mesh) { arena->FreeVertices(mesh.baseVertex, mesh.vertexCount); }
+
+    void GeneratorMain() {
+        Profiler::Get().SetThreadName("Terrain Generator");
+        while (true) {
+            BuildRequest request;
+            {
+                std::unique_lock<std::mutex> lock(requestsMutex);
+                requestsReady.wait(lock, [this] { return stopping || !requests.empty(); });
+                if (stopping) {
+                    return;
+                }
+                request = requests.front();
+                requests.pop_front();
+            }
+
+            BuiltChunk chunk = Build(request);
+            if (!built.Push(std::move(chunk))) {
+                return;
+            }
+        }
+    }
+
+    BuiltChunk Build(const BuildRequest &request) const {
+        PROFILE_ZONE("GenerateChunk");
+        const uint32_t quads = QuadsPerSide(request.shape.lod);
+        const uint32_t row = quads + 1;
+        const float spacing = CHUNK_SIZE / float(quads);
+        const glm::vec2 origin(request.x * CHUNK_SIZE, request.z * CHUNK_SIZE);
+
+        // Heights on the chunk's grid, with edge vertices missing from a
+        // coarser neighbour moved onto the line between the ones it has
+        std::vector<float> heights(size_t(row) * row);
+        for (uint32_t j = 0; j < row; j++) {
+            for (uint32_t i = 0; i < row; i++) {
+                heights[j * row + i] = heightfield.Height(origin.x + i * spacing, origin.y + j * spacing);
+            }
+        }
+        for (int edge = 0; edge < 4; edge++) {
+            int coarser = int(request.shape.neighbourLods[edge]) - int(request.shape.lod);
+            if (coarser <= 0) {
+                continue;
+            }
+            uint32_t step = 1u << coarser;
+            auto at = [&](uint32_t k) -> float & {
+                switch (edge) {
+                case 0: return heights[k * row];
+                case 1: return heights[k * row + quads];
+                case 2: return heights[k];
+                default: return heights[quads * row + k];
+                }
+            };
+            for (uint32_t k = 0; k < row; k++) {
+                uint32_t offset = k % step;
+                if (offset != 0) {
+                    float t = float(offset) / float(step);
+                    at(k) = glm::mix(at(k - offset), at(k - offset + step), t);
+                }
+            }
+        }
+
+        BuiltChunk chunk;
+        chunk.x = request.x;
+        chunk.z = request.z;
+        chunk.shape = request.shape;
+
+        float minHeight = heights[0], maxHeight = heights[0];
+        for (float height : heights) {
+            minHeight = std::min(minHeight, height);
+            maxHeight = std::max(maxHeight, height);
+        }
+        chunk.bounds = AABB(glm::vec3(origin.x, minHeight, origin.y),
+                            glm::vec3(origin.x + CHUNK_SIZE, maxHeight, origin.y + CHUNK_SIZE));
+        chunk.occluder = BuildOccluder(heights, quads, origin);
+
+        // Heights are quantized over the whole terrain's range rather than
+        // the chunk's, so vertices shared by neighbours encode identically
+        const float center[3] = {origin.x + 0.5f * CHUNK_SIZE, 0.5f * (Heightfield::MinHeight() + Heightfield::MaxHeight()),
+                                 origin.y + 0.5f * CHUNK_SIZE};
+        const float halfExtent[3] = {0.5f * CHUNK_SIZE, 0.5f * (Heightfield::MaxHeight() - Heightfield::MinHeight()),
+                                     0.5f * CHUNK_SIZE};
+        float offset[3], scale[3];
+        ChooseDequantization(layout, center, halfExtent, offset, scale);
+        chunk.positionOffset = glm::vec3(offset[0], offset[1], offset[2]);
+        chunk.positionScale = glm::vec3(scale[0], scale[1], scale[2]);
+
+        const VertexFormat &format = GetVertexFormat(layout);
+        chunk.vertices.resize(size_t(format.stride) * row * row);
+        for (uint32_t j = 0; j < row; j++) {
+            for (uint32_t i = 0; i < row; i++) {
+                glm::vec3 position(origin.x + i * spacing, heights[j * row + i], origin.y + j * spacing);
+                // shading follows the true surface, so it does not pop with LOD
+                glm::vec3 normal = heightfield.Normal(position.x, position.z, 0.5f);
+                glm::vec3 color = Heightfield::Color(position.y, normal);
+
+                float stored[3];
+                for (int axis = 0; axis < 3; axis++) {
+                    stored[axis] = scale[axis] != 0.0f ? (position[axis] - offset[axis]) / scale[axis] : 0.0f;
+                }
+                WriteVertex(format, chunk.vertices.data() + size_t(j * row + i) * format.stride, stored,
+                            &normal.x, &color.x);
+            }
+        }
+        return chunk;
+    }
+
+    // Every occluder vertex sits at the lowest mesh height of the occluder
+    // cells around it, so each occluder triangle stays on or below the
+    // mesh quads it spans
+    static std::vector<glm::vec3> BuildOccluder(const std::vector<float> &heights, uint32_t quads,
+                                                const glm::vec2 &origin) {
+        const uint32_t row = quads + 1;
+        const uint32_t quadsPerCell = quads / OCCLUDER_QUADS;
+        std::vector<float> cellLowest(OCCLUDER_QUADS * OCCLUDER_QUADS, FLT_MAX);
+        for (uint32_t j = 0; j < row; j++) {
+            for (uint32_t i = 0; i < row; i++) {
+                // a mesh vertex on a cell border belongs to the cells on both sides
+                uint32_t firstCellX = i == 0 ? 0 : (i - 1) / quadsPerCell;
+                uint32_t lastCellX = std::min(i / quadsPerCell, OCCLUDER_QUADS - 1);
+                uint32_t firstCellZ = j == 0 ? 0 : (j - 1) / quadsPerCell;
+                uint32_t lastCellZ = std::min(j / quadsPerCell, OCCLUDER_QUADS - 1);
+                for (uint32_t cz = firstCellZ; cz <= lastCellZ; cz++) {
+                    for (uint32_t cx = firstCellX; cx <= lastCellX; cx++) {
+                        float &lowest = cellLowest[cz * OCCLUDER_QUADS + cx];
+                        lowest = std::min(lowest, heights[j * row + i]);
+                    }
+                }
+            }
+        }
+
+        const uint32_t occluderRow = OCCLUDER_QUADS + 1;
+        const float spacing = CHUNK_SIZE / float(OCCLUDER_QUADS);
+        std::vector<glm::vec3> vertices;
+        vertices.reserve(occluderRow * occluderRow);
+        for (uint32_t j = 0; j < occluderRow; j++) {
+            for (uint32_t i = 0; i < occluderRow; i++) {
+                float height = FLT_MAX;
+                for (uint32_t cz = (j == 0 ? 0 : j - 1); cz <= std::min(j, OCCLUDER_QUADS - 1); cz++) {
+                    for (uint32_t cx = (i == 0 ? 0 : i - 1); cx <= std::min(i, OCCLUDER_QUADS - 1); cx++) {
+                        height = std::min(height, cellLowest[cz * OCCLUDER_QUADS + cx]);
+                    }
+                }
+                vertices.push_back(glm::vec3(origin.x + i * spacing, height, origin.y + j * spacing));
+            }
+        }
+        return vertices;
+    }
+
+    Heightfield heightfield;
+    MeshVertexLayout layout = MeshVertexLayout::PositionColor;
+
+    std::thread generator;
+    std::deque<BuildRequest> requests;
+    std::mutex requestsMutex;
+    std::condition_variable requestsReady;
+    bool stopping = false;
+    BoundedQueue<BuiltChunk> built;
+    const std::vector<uint32_t> occluderIndices;
+
+    // Only touched by the GL thread
+    GeometryArena *arena = nullptr;
+    ArenaMesh lodIndices[LOD_COUNT];
+    std::unordered_map<uint64_t, Chunk> chunks;
+    bool planned = false;
+    int32_t centerX = 0, centerZ = 0;
+    // wanted chunks with neither a fitting shown nor staged mesh
+    int pending = 0;
+    bool swapWanted = false;
+};
+
+#endif // TERRAIN_HPP
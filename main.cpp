@@ -1,11 +1,109 @@
 #include "app/app.hpp"
 
-int main() {
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+static void PrintUsage(const char *program) {
+    std::cerr << "Usage: " << program << " [--headless] [--frames N] [--timestep SECONDS] [--tick-rate HZ]"
+              << " [--profile PATH] [--record PATH | --replay PATH]" << std::endl;
+}
+
+// Parses a whole argument as a positive number
+static bool ParsePositive(const char *text, int &value) {
+    char *end = nullptr;
+    errno = 0;
+    long parsed = std::strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || parsed <= 0 || parsed > INT_MAX) {
+        return false;
+    }
+    value = int(parsed);
+    return true;
+}
+
+static bool ParsePositive(const char *text, double &value) {
+    char *end = nullptr;
+    errno = 0;
+    double parsed = std::strtod(text, &end);
+    if (end == text || *end != '\0' || errno == ERANGE || !(parsed > 0.0)) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+int main(int argc, char *argv[]) {
 
     const char *vertexShader = "shaders/vert.vs";
     const char *fragmentShader = "shaders/frag.fs";
+    const char *instancedVertexShader = "shaders/instanced.vs";
 
-    App app(1920, 1080, "OpenGL Window", vertexShader, fragmentShader);
+    // --headless [--frames N] [--timestep SECONDS] runs the offscreen benchmark
+    // --profile PATH writes a Chrome trace (PATH.json) and summary (PATH.csv)
+    // --tick-rate HZ sets the fixed simulation rate
+    // --record PATH records the input of a windowed run; --replay PATH plays
+    // it back (also with --headless) with the recorded frame timing
+    HeadlessSettings headless;
+    std::string profilePath;
+    std::string recordPath;
+    std::string replayPath;
+    double tickRate = 120.0;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            headless.enabled = true;
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            if (!ParsePositive(argv[++i], headless.frames)) {
+                std::cerr << "--frames takes a positive frame count, not " << argv[i] << std::endl;
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--timestep") == 0 && i + 1 < argc) {
+            double timestep = 0.0;
+            if (!ParsePositive(argv[++i], timestep) || !(static_cast<float>(timestep) > 0.0f)) {
+                std::cerr << "--timestep takes a positive number of seconds, not " << argv[i] << std::endl;
+                PrintUsage(argv[0]);
+                return 1;
+            }
+            headless.timestep = static_cast<float>(timestep);
+        } else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profilePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc) {
+            if (!ParsePositive(argv[++i], tickRate)) {
+                std::cerr << "--tick-rate takes a positive rate in Hz, not " << argv[i] << std::endl;
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else {
+            std::cerr << "Unknown argument: " << argv[i] << std::endl;
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (!recordPath.empty() && !replayPath.empty()) {
+        std::cerr << "--record and --replay cannot be combined" << std::endl;
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    if (!recordPath.empty() && headless.enabled) {
+        std::cerr << "--record needs a windowed run; headless runs take no input" << std::endl;
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    App app(1920, 1080, "OpenGL Window", vertexShader, fragmentShader,
+            instancedVertexShader);
+    app.SetHeadless(headless);
+    app.SetProfileOutput(profilePath);
+    app.SetTickRate(tickRate);
+    if ((!recordPath.empty() && !app.SetInputRecording(recordPath)) ||
+        (!replayPath.empty() && !app.SetInputReplay(replayPath))) {
+        return 1;
+    }
     if (app.Initialize()) {
         app.Run();
     } else {
@@ -0,0 +1,32 @@
+#version 410 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aColor;
+layout (location = 2) in uint aInstanceIndex; // per instance
+
+out vec3 ourColor;
+
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+};
+
+// Five texels per instance: the four model matrix columns, then the color
+uniform samplerBuffer instanceData;
+
+// Per-mesh dequantization of the stored positions
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+void main()
+{
+    int base = int(aInstanceIndex) * 5;
+    mat4 model = mat4(texelFetch(instanceData, base),
+                      texelFetch(instanceData, base + 1),
+                      texelFetch(instanceData, base + 2),
+                      texelFetch(instanceData, base + 3));
+    vec4 instanceColor = texelFetch(instanceData, base + 4);
+
+    gl_Position = projection * view * model * vec4(positionOffset + positionScale * aPos, 1.0);
+    ourColor = aColor * instanceColor.rgb;
+}
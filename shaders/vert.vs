@@ -4,11 +4,20 @@ layout (location = 1) in vec3 aColor;
 
 out vec3 ourColor;
 
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+};
+
+uniform mat4 model;
+
+// Per-mesh dequantization of the stored positions
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
 
 void main()
 {
-    gl_Position = projection * view * vec4(aPos, 1.0);
+    gl_Position = projection * view * model * vec4(positionOffset + positionScale * aPos, 1.0);
     ourColor = aColor;
 }
@@ -1,36 +1,106 @@
 #include "app/app.hpp"
 
-App::App(int width, int height, const std::string& title, const char* vertexShader, const char* fragmentShader) {
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <thread>
+
+#ifdef APP_HAS_EGL
+// Keep X11 out of the EGL headers; it would clash with SDL and glad
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// A cube as an occluder: its own box, placed by the body's matrix
+static const glm::vec3 CUBE_OCCLUDER_VERTICES[] = {
+    {-App::CUBE_HALF_EXTENT, -App::CUBE_HALF_EXTENT, -App::CUBE_HALF_EXTENT},
+    {App::CUBE_HALF_EXTENT, -App::CUBE_HALF_EXTENT, -App::CUBE_HALF_EXTENT},
+    {App::CUBE_HALF_EXTENT, App::CUBE_HALF_EXTENT, -App::CUBE_HALF_EXTENT},
+    {-App::CUBE_HALF_EXTENT, App::CUBE_HALF_EXTENT, -App::CUBE_HALF_EXTENT},
+    {-App::CUBE_HALF_EXTENT, -App::CUBE_HALF_EXTENT, App::CUBE_HALF_EXTENT},
+    {App::CUBE_HALF_EXTENT, -App::CUBE_HALF_EXTENT, App::CUBE_HALF_EXTENT},
+    {App::CUBE_HALF_EXTENT, App::CUBE_HALF_EXTENT, App::CUBE_HALF_EXTENT},
+    {-App::CUBE_HALF_EXTENT, App::CUBE_HALF_EXTENT, App::CUBE_HALF_EXTENT},
+};
+// counter-clockwise seen from outside
+static const uint32_t CUBE_OCCLUDER_INDICES[] = {
+    0, 3, 2, 0, 2, 1, // -Z
+    4, 5, 6, 4, 6, 7, // +Z
+    0, 4, 7, 0, 7, 3, // -X
+    1, 2, 6, 1, 6, 5, // +X
+    0, 1, 5, 0, 5, 4, // -Y
+    3, 7, 6, 3, 6, 2, // +Y
+};
+
+App::App(int width, int height, const std::string& title, const char* vertexShader, const char* fragmentShader, const char* instancedVertexShader)
+    : frameMemory(FRAME_MEMORY_BYTES), fpsInputHandler(fpsCamera), arcballInputHandler(arcballCamera) {
     screenWidth = width;
     screenHeight = height;
     windowTitle = title;
     vertexShaderPath = vertexShader;
     fragmentShaderPath = fragmentShader;
+    instancedVertexShaderPath = instancedVertexShader;
 
     window = nullptr;
     context = nullptr;
+    shader = nullptr;
+    instancedShader = nullptr;
+    modelLocation = -1;
+    eglDisplay = nullptr;
+    eglContext = nullptr;
+    offscreenFBO = offscreenColorRBO = offscreenDepthRBO = 0;
+    std::fill(std::begin(uploadedPhysicsTicks), std::end(uploadedPhysicsTicks), 0);
+    cubeBoundsTick = 0;
+    cubeMaterial = 0;
+    terrainEntity = TransformSystem::NO_PARENT;
     quit = false;
 
     fpsCamera = FPSCamera(glm::vec3(0.0f, 0.0f, 3.0f));
-    fpsInputHandler = new FPSInputHandler(fpsCamera);
-
     arcballCamera = ArcballCamera(glm::vec3(0.0f, 0.0f, 5.0f));
-    arcballInputHandler = new ArcballInputHandler(arcballCamera);
+
+    float aspectRatio = (float)screenWidth / (float)screenHeight;
+    fpsCamera.SetProjection(aspectRatio, NEAR_PLANE, FAR_PLANE);
+    arcballCamera.SetProjection(aspectRatio, NEAR_PLANE, FAR_PLANE);
+    uploadedCamera = nullptr;
+    uploadedCameraVersion = 0;
 
     deltaTime = 0.0f;
-    lastFrame = 0.0f;
+    lastCounter = 0;
+    renderAlpha = 0.0f;
+    fpsCameraPosition.Reset(fpsCamera.Position);
 
     // Default to FPS camera
     activeCameraType = CameraType::FPS;
-    activeInputHandler = fpsInputHandler;
+    activeInputHandler = &fpsInputHandler;
 }
 
-App::~App() {
-    delete fpsInputHandler;
-    delete arcballInputHandler;
+void App::SetHeadless(const HeadlessSettings &settings) {
+    headless = settings;
 }
 
 bool App::Initialize() {
+    bool contextReady = headless.enabled ? InitHeadlessContext() : InitWindow();
+    if (!contextReady) {
+        return false;
+    }
+
+    GetOpenGLVersionInfo();
+    // The main thread takes part in the jobs, so one worker per other core
+    jobs.Start(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+    InitOpenGL();
+
+    if (headless.enabled) {
+        InitOffscreenTarget();
+    }
+
+    InitScene();
+    InitPhysics();
+    return true;
+}
+
+bool App::InitWindow() {
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         std::cerr << "SDL2 could not initialize video subsystem." << std::endl;
         return false;
@@ -63,28 +133,270 @@ bool App::Initialize() {
         std::cerr << "GLAD could not initialize OpenGL context." << std::endl;
         return false;
     }
+    return true;
+}
 
-    GetOpenGLVersionInfo();
-    InitOpenGL();
+bool App::InitHeadlessContext() {
+#ifdef APP_HAS_EGL
+    // Prefer Mesa's surfaceless platform, which needs neither a display
+    // server nor a GPU (llvmpipe works), then fall back to the default display
+    EGLDisplay display = EGL_NO_DISPLAY;
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        std::cerr << "EGL display could not be initialized." << std::endl;
+        return false;
+    }
+    eglDisplay = display;
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "EGL could not bind the desktop OpenGL API." << std::endl;
+        return false;
+    }
+
+    // We never create an EGL surface, so accept any surface type
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, 0,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0) {
+        std::cerr << "EGL could not find a suitable config." << std::endl;
+        return false;
+    }
 
-    // TODO: Init physics here?
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 1,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext ctx = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (ctx == EGL_NO_CONTEXT) {
+        std::cerr << "EGL OpenGL context could not be created." << std::endl;
+        return false;
+    }
+    eglContext = ctx;
+
+    // Surfaceless: all rendering goes into the offscreen framebuffer
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx)) {
+        std::cerr << "EGL context could not be made current without a surface." << std::endl;
+        return false;
+    }
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+        std::cerr << "GLAD could not initialize OpenGL context." << std::endl;
+        return false;
+    }
     return true;
+#else
+    std::cerr << "Headless mode requires EGL, which was not found at build time." << std::endl;
+    return false;
+#endif
+}
+
+void App::InitOffscreenTarget() {
+    glGenRenderbuffers(1, &offscreenColorRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, offscreenColorRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, screenWidth, screenHeight);
+
+    glGenRenderbuffers(1, &offscreenDepthRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, offscreenDepthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, screenWidth, screenHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &offscreenFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, offscreenFBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreenColorRBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, offscreenDepthRBO);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Offscreen framebuffer is incomplete." << std::endl;
+    }
+
+    glViewport(0, 0, screenWidth, screenHeight);
 }
 
 void App::Run() {
+    if (headless.enabled) {
+        RunBenchmark();
+        return;
+    }
+
+    const double counterFrequency = static_cast<double>(SDL_GetPerformanceFrequency());
+    lastCounter = SDL_GetPerformanceCounter();
+
     while (!quit) {
-        float currentFrame = SDL_GetTicks() / 1000.0f;
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        Uint64 currentCounter = SDL_GetPerformanceCounter();
+        double frameSeconds = (currentCounter - lastCounter) / counterFrequency;
+        lastCounter = currentCounter;
+        frameMemory.BeginFrame();
+
+        {
+            PROFILE_ZONE("Frame");
+            {
+                PROFILE_ZONE("ProcessInput");
+                ProcessInput(frameSeconds);
+            }
+            {
+                PROFILE_ZONE("Update");
+                Simulate(frameSeconds);
+            }
+            {
+                PROFILE_ZONE("ReloadShaders");
+                ReloadChangedShaders();
+            }
+            {
+                PROFILE_ZONE("StreamAssets");
+                assets.ProcessUploads(ASSET_UPLOAD_BUDGET_SECONDS);
+            }
+            {
+                PROFILE_ZONE("StreamTerrain");
+                StreamTerrain(false);
+            }
+            {
+                PROFILE_ZONE("Render");
+                Render();
+            }
+            {
+                PROFILE_ZONE("Swap");
+                SDL_GL_SwapWindow(window);
+            }
+        }
+        EndProfilerFrame();
+    }
+    WriteProfile();
+    CleanUp();
+}
 
-        ProcessInput();
-        Update();
-        Render();
-        SDL_GL_SwapWindow(window);
+void App::RunBenchmark() {
+    FrameTimeRecorder recorder;
+    recorder.Reserve(headless.frames);
+
+    // Every frame advances by the same timestep, so two runs of the same build
+    // simulate and submit exactly the same work. That includes the assets:
+    // wait for all of them instead of streaming them in
+    assets.Flush();
+    for (int frame = 0; inputReplay.IsOpen() || frame < headless.frames; ++frame) {
+        frameMemory.BeginFrame();
+
+        // A replayed recording drives the camera and the timing; otherwise
+        // the camera follows a script at the fixed timestep
+        double frameSeconds = headless.timestep;
+        if (inputReplay.IsOpen()) {
+            ProcessInput(frameSeconds);
+            if (quit) {
+                break;
+            }
+        } else {
+            ScriptCamera(frame * headless.timestep);
+            deltaTime = headless.timestep;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        {
+            PROFILE_ZONE("Frame");
+            {
+                PROFILE_ZONE("Update");
+                Simulate(frameSeconds);
+            }
+            {
+                PROFILE_ZONE("StreamTerrain");
+                StreamTerrain(true);
+            }
+            {
+                PROFILE_ZONE("Render");
+                Render();
+            }
+            {
+                // Wait for the GPU so the measurement covers the whole frame
+                PROFILE_ZONE("Finish");
+                glFinish();
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        recorder.Record(std::chrono::duration<double, std::milli>(end - start).count(), frameStats);
+        EndProfilerFrame();
     }
+
+    recorder.Report(std::cout);
+    std::cout << "Pooled objects (peak): " << physics.PeakRigidBodyCount() << " rigid bodies, "
+              << programs.PeakCount() << " programs" << std::endl;
+    std::cout << "Stream buffer: " << (frameStream.IsPersistent() ? "persistent mapping" : "orphaning") << ", "
+              << frameStream.Stalls() << " stalls" << std::endl;
+    WriteProfile();
     CleanUp();
 }
 
+bool App::SetInputRecording(const std::string &path) {
+    return inputRecorder.Open(path);
+}
+
+bool App::SetInputReplay(const std::string &path) {
+    if (!inputReplay.Open(path)) {
+        return false;
+    }
+    std::cout << "Replaying " << inputReplay.FrameCount() << " frames from " << path << std::endl;
+    return true;
+}
+
+void App::SetProfileOutput(const std::string &basePath) {
+    profileOutputPath = basePath;
+    Profiler::Get().SetEnabled(!basePath.empty());
+    Profiler::Get().SetThreadName("Main");
+}
+
+void App::EndProfilerFrame() {
+    gpuTimer.EndFrame();
+    Profiler::Get().EndFrame();
+}
+
+void App::WriteProfile() {
+    if (profileOutputPath.empty()) {
+        return;
+    }
+
+    std::string tracePath = profileOutputPath + ".json";
+    std::string summaryPath = profileOutputPath + ".csv";
+    if (Profiler::Get().WriteChromeTrace(tracePath) && Profiler::Get().WriteCsvSummary(summaryPath)) {
+        std::cout << "Profile written to " << tracePath << " and " << summaryPath << std::endl;
+    } else {
+        std::cerr << "Profile could not be written to " << profileOutputPath << std::endl;
+    }
+    if (Profiler::Get().DroppedEvents() > 0) {
+        std::cerr << "Profiler dropped " << Profiler::Get().DroppedEvents() << " zones." << std::endl;
+    }
+}
+
+void App::ScriptCamera(float time) {
+    // Fly the FPS camera on a slow circle around the scene, looking at its center
+    const float radius = 30.0f;
+    const float height = 8.0f;
+    const float angularSpeed = 0.25f;
+
+    float angle = time * angularSpeed;
+    fpsCamera.Position = glm::vec3(radius * cos(angle), height, radius * sin(angle));
+    fpsCamera.Front = glm::normalize(-fpsCamera.Position);
+    fpsCamera.Yaw = glm::degrees(atan2(fpsCamera.Front.z, fpsCamera.Front.x));
+    fpsCamera.Pitch = glm::degrees(asin(fpsCamera.Front.y));
+    // zero offsets only recompute the Right/Up vectors from the new angles
+    fpsCamera.ProcessMouseMovement(0.0f, 0.0f);
+    fpsCameraPosition.Reset(fpsCamera.Position);
+}
+
+void App::SetTickRate(double ticksPerSecond) {
+    timestep.SetTickRate(ticksPerSecond);
+}
+
 void App::GetOpenGLVersionInfo() {
     std::cout << "=============================================================" << std::endl;
     std::cout << "Vendor: " << glGetString(GL_VENDOR) << std::endl;
@@ -96,147 +408,542 @@ void App::GetOpenGLVersionInfo() {
 }
 
 void App::InitOpenGL() {
-    shader = new Shader(vertexShaderPath, fragmentShaderPath);
-
-    // Generate random colors for the vertices every build and run
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis(0.0, 1.0);
-
-    float cubeVertices[] = {
-        // positions           // colors
-        -0.5f, -0.5f, -0.5f,   float(dis(gen)), float(dis(gen)), float(dis(gen)),
-         0.5f, -0.5f, -0.5f,   float(dis(gen)), float(dis(gen)), float(dis(gen)),
-         0.5f,  0.5f, -0.5f,   float(dis(gen)), float(dis(gen)), float(dis(gen)),
-        -0.5f,  0.5f, -0.5f,   float(dis(gen)), float(dis(gen)), float(dis(gen)),
-        -0.5f, -0.5f,  0.5f,   float(dis(gen)), float(dis(gen)), float(dis(gen)),
-         0.5f, -0.5f,  0.5f,   float(dis(gen)), float(dis(gen)), float(dis(gen)),
-         0.5f,  0.5f,  0.5f,   float(dis(gen)), float(dis(gen)), float(dis(gen)),
-        -0.5f,  0.5f,  0.5f,   float(dis(gen)), float(dis(gen)), float(dis(gen))
-    };
+    // Every program reads view/projection from the shared camera uniform block
+    cameraUniforms.Create();
+
+    // Per-instance transforms and colors, read by the instanced shader through
+    // a texture buffer; the cube VAO only carries the indices of visible cubes
+    InitCubeInstances();
+    cubeInstanceBuffer.Create(cubeInstances);
+    cubeMaterial = renderQueue.AddMaterial({INSTANCE_DATA_TEXTURE_UNIT, GL_TEXTURE_BUFFER, cubeInstanceBuffer.Texture});
+
+    geometry.Create(GEOMETRY_VERTEX_LAYOUT, GEOMETRY_VERTEX_CAPACITY, GEOMETRY_INDEX_CAPACITY);
+    // Per-frame draw data (visible cube indices, indirect commands) streams
+    // through one ring buffer
+    frameStream.Create(cubeInstances.size() * sizeof(uint32_t) +
+                       MAX_DRAW_COMMANDS * sizeof(DrawElementsIndirectCommand) + StreamBuffer::REGION_ALIGNMENT);
+    visibleCubes.Create(geometry.VAO, cubeInstances.size(), frameStream);
+    indirectDraws.Create(MAX_DRAW_COMMANDS, frameStream);
+
+    // Shaders and meshes are read by the loader threads and created here on
+    // the GL thread as they arrive; until then their draws are skipped
+    Shader::enableParallelCompile();
+    assets.Start(ASSET_LOADER_THREADS, &geometry);
+    terrain.Start(&geometry);
+    assets.LoadShader(vertexShaderPath, fragmentShaderPath, [this](const ShaderSources &sources) {
+        shader = programs.Create(sources, &programBinaryCache);
+        ConfigureShader(shader);
+    });
+    assets.LoadShader(instancedVertexShaderPath, fragmentShaderPath, [this](const ShaderSources &sources) {
+        instancedShader = programs.Create(sources, &programBinaryCache);
+        ConfigureShader(instancedShader);
+    });
+    assets.LoadMesh(CUBE_MESH_PATH, [this](const ArenaMesh &mesh) {
+        cubeMesh = mesh;
+    });
+
+    if (!headless.enabled) {
+        shaderWatcher.Watch(vertexShaderPath);
+        shaderWatcher.Watch(fragmentShaderPath);
+        shaderWatcher.Watch(instancedVertexShaderPath);
+    }
 
-    unsigned int cubeIndices[] = {
-        0, 1, 2, 2, 3, 0,    // front face
-        4, 5, 6, 6, 7, 4,    // back face
-        0, 1, 5, 5, 4, 0,    // bottom face
-        2, 3, 7, 7, 6, 2,    // top face
-        0, 3, 7, 7, 4, 0,    // left face
-        1, 2, 6, 6, 5, 1     // right face
-    };
+    GLStateCache::Get().SetCapability(GL_DEPTH_TEST, true);
+}
 
-    float planeVertices[] = {
-        // positions            // colors
-        -50.0f, -0.5f,  50.0f,  0.8f, 0.8f, 0.8f,
-         50.0f, -0.5f,  50.0f,  0.8f, 0.8f, 0.8f,
-         50.0f, -0.5f, -50.0f,  0.8f, 0.8f, 0.8f,
-        -50.0f, -0.5f, -50.0f,  0.8f, 0.8f, 0.8f
-    };
+void App::ConfigureShader(Shader *program) {
+    // Every program reads view/projection from the shared camera uniform block
+    program->bindUniformBlock(CameraUniformBuffer::BLOCK_NAME, CameraUniformBuffer::BINDING);
+    PositionLocations locations;
+    locations.offset = program->getUniformLocation("positionOffset");
+    locations.scale = program->getUniformLocation("positionScale");
+    if (program == shader) {
+        modelLocation = shader->getUniformLocation("model");
+        shaderPositionLocations = locations;
+    } else if (program == instancedShader) {
+        instancedShaderPositionLocations = locations;
+        instancedShader->use();
+        instancedShader->setInt("instanceData", INSTANCE_DATA_TEXTURE_UNIT);
+    }
+}
 
-    unsigned int planeIndices[] = {
-        0, 1, 2,
-        2, 3, 0
+void App::ReloadChangedShaders() {
+    changedShaderFiles.clear();
+    shaderWatcher.Poll(changedShaderFiles);
+    auto changed = [this](const char *path) {
+        return std::find(changedShaderFiles.begin(), changedShaderFiles.end(), path) != changedShaderFiles.end();
     };
 
-    // Cube VAO
-    glGenVertexArrays(1, &cubeVAO);
-    glGenBuffers(1, &cubeVBO);
-    glGenBuffers(1, &cubeEBO);
+    // Sources are read on the loader threads; the new program is then built
+    // while the old one keeps rendering
+    if (shader && (changed(vertexShaderPath) || changed(fragmentShaderPath))) {
+        assets.LoadShader(vertexShaderPath, fragmentShaderPath, [this](const ShaderSources &sources) {
+            shader->beginReload(sources);
+        });
+    }
+    if (instancedShader && (changed(instancedVertexShaderPath) || changed(fragmentShaderPath))) {
+        assets.LoadShader(instancedVertexShaderPath, fragmentShaderPath, [this](const ShaderSources &sources) {
+            instancedShader->beginReload(sources);
+        });
+    }
+
+    for (auto [program, name] : {std::pair{shader, vertexShaderPath}, std::pair{instancedShader, instancedVertexShaderPath}}) {
+        if (!program) {
+            continue;
+        }
+        switch (program->pollReload()) {
+        case Shader::ReloadStatus::Swapped:
+            ConfigureShader(program);
+            std::cout << "Reloaded " << name << std::endl;
+            break;
+        case Shader::ReloadStatus::Failed:
+            std::cerr << "Reloading " << name << " failed; keeping the previous program." << std::endl;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void App::InitCubeInstances() {
+    // Benchmarks, replays and the recordings they replay must all start from
+    // the same scene; only free-running windowed sessions vary
+    bool reproducible = IsDeterministic() || inputRecorder.IsOpen();
+    std::mt19937 gen(reproducible ? CUBE_LAYOUT_SEED : std::random_device()());
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // Spread the cubes evenly over the plane, at random heights and orientations
+    const float spacing = 90.0f / CUBE_GRID_SIZE;
+    const float origin = -0.5f * spacing * (CUBE_GRID_SIZE - 1);
+
+    cubeInstances.clear();
+    cubeInstances.reserve(CUBE_GRID_SIZE * CUBE_GRID_SIZE);
+    for (int x = 0; x < CUBE_GRID_SIZE; ++x) {
+        for (int z = 0; z < CUBE_GRID_SIZE; ++z) {
+            glm::vec3 position(origin + x * spacing, 4.0f * unit(gen) + 0.5f, origin + z * spacing);
+            glm::vec3 axis = glm::normalize(glm::vec3(unit(gen), unit(gen), unit(gen)) + 0.01f);
+
+            InstanceData instance;
+            instance.model = glm::translate(glm::mat4(1.0f), position);
+            instance.model = glm::rotate(instance.model, glm::radians(360.0f * unit(gen)), axis);
+            instance.color = glm::vec4(unit(gen), unit(gen), unit(gen), 1.0f);
+            cubeInstances.push_back(instance);
+        }
+    }
+}
+
+void App::InitScene() {
+    terrainEntity = scene.Create();
+    scene.Update();
+}
+
+void App::InitPhysics() {
+    // The terrain is flat around the origin, where the cubes are; drop every
+    // cube onto it from where it spawned
+    physics.AddGroundPlane(Heightfield::GROUND_HEIGHT);
+    for (const InstanceData &instance : cubeInstances) {
+        physics.AddBox(glm::vec3(CUBE_HALF_EXTENT), 1.0f, instance.model);
+    }
+
+    // Cull cubes through a BVH over their bounds, refitted as bodies move
+    std::vector<AABB> bounds;
+    bounds.reserve(cubeInstances.size());
+    for (const InstanceData &instance : cubeInstances) {
+        bounds.push_back(AABB::FromCenterRadius(glm::vec3(instance.model[3]), CUBE_BOUNDING_RADIUS));
+    }
+    cubeBVH.Build(bounds);
+
+    // Headless and replayed runs step physics in Update() so every run is
+    // reproducible; otherwise it runs on its own thread, overlapping with
+    // rendering
+    if (!IsDeterministic()) {
+        physics.Start(1.0 / timestep.TickDelta());
+    }
+}
+
+void App::UploadPhysicsTransforms(const PhysicsSnapshot &snapshot) {
+    static_assert(sizeof(btScalar) == sizeof(float), "instance matrices are uploaded as floats");
+
+    // Each frame writes its own copy of the instances, which is FRAMES
+    // uploads behind; only bodies that moved since that copy was written are
+    // rewritten. Find their span first so the mapping covers as little of
+    // the buffer as possible.
+    uint64_t &uploadedPhysicsTick = uploadedPhysicsTicks[cubeInstanceBuffer.Region()];
+    if (snapshot.tick == uploadedPhysicsTick) {
+        return;
+    }
+
+    size_t count = snapshot.modifiedTicks.size();
+    size_t first = count, last = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (snapshot.modifiedTicks[i] > uploadedPhysicsTick) {
+            first = std::min(first, i);
+            last = i;
+        }
+    }
+
+    if (first < count) {
+        // Bullet already wrote the matrices in OpenGL layout; copy them as-is
+        InstanceData *mapped = cubeInstanceBuffer.MapRange(GLsizei(first), GLsizei(last - first + 1));
+        if (mapped) {
+            // The copies are spread over the job threads; only mapping and
+            // unmapping need the GL context
+            jobs.ParallelFor(uint32_t(last - first + 1), 1024, [&](uint32_t begin, uint32_t end) {
+                for (size_t i = first + begin; i < first + end; i++) {
+                    if (snapshot.modifiedTicks[i] > uploadedPhysicsTick) {
+                        std::memcpy(glm::value_ptr(mapped[i - first].model), &snapshot.matrices[16 * i],
+                                    sizeof(glm::mat4));
+                    }
+                }
+            });
+            cubeInstanceBuffer.Unmap();
+        }
+    }
+    uploadedPhysicsTick = snapshot.tick;
+}
+
+void App::RefitCubeBounds(const PhysicsSnapshot &snapshot) {
+    if (snapshot.tick == cubeBoundsTick) {
+        return;
+    }
+
+    // The bounding sphere of a cube does not depend on its rotation, so only
+    // the translation column of the body matrix is needed
+    for (size_t i = 0; i < snapshot.modifiedTicks.size(); ++i) {
+        if (snapshot.modifiedTicks[i] > cubeBoundsTick) {
+            const btScalar *m = &snapshot.matrices[16 * i];
+            glm::vec3 center(m[12], m[13], m[14]);
+            cubeBVH.UpdateObject(uint32_t(i), AABB::FromCenterRadius(center, CUBE_BOUNDING_RADIUS));
+        }
+    }
+    cubeBVH.Refit();
+    cubeBoundsTick = snapshot.tick;
+}
+
+void App::SortVisibleCubes(const glm::vec3 &eye) {
+    // Front to back, so early-Z rejects the hidden fragments of cubes behind
+    // nearer ones. Distances are bucketed like the render queue's depth key.
+    PROFILE_ZONE("SortCubes");
+    const float bucketsPerUnit = float((1u << 24) - 1) / FAR_PLANE;
+
+    uint32_t count = uint32_t(visibleCubeIndices.size());
+    SortEntry *entries = frameMemory.Allocate<SortEntry>(count);
+    SortEntry *scratch = frameMemory.Allocate<SortEntry>(count);
+    jobs.ParallelFor(count, 4096, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t cube = visibleCubeIndices[i];
+            float distance = glm::distance(eye, cubeBVH.ObjectBounds(cube).Center());
+            entries[i] = {uint64_t(std::min(distance * bucketsPerUnit, float((1u << 24) - 1))), cube};
+        }
+    });
+    entries = RadixSort(entries, scratch, count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        visibleCubeIndices[i] = entries[i].index;
+    }
+}
+
+glm::mat4 App::CubeModelMatrix(const PhysicsSnapshot &snapshot, uint32_t cube) const {
+    // bodies that never moved are still where they spawned
+    if (cube >= snapshot.modifiedTicks.size() || snapshot.modifiedTicks[cube] == 0) {
+        return cubeInstances[cube].model;
+    }
+    glm::mat4 model;
+    const btScalar *m = &snapshot.matrices[16 * size_t(cube)];
+    for (int i = 0; i < 16; i++) {
+        glm::value_ptr(model)[i] = float(m[i]);
+    }
+    return model;
+}
 
-    glBindVertexArray(cubeVAO);
+void App::CullCubes(const PhysicsSnapshot &snapshot, const Frustum &frustum, const glm::vec3 &eye) {
+    RefitCubeBounds(snapshot);
+    visibleCubeIndices.clear();
+    if (!cubeMesh.IsLoaded()) {
+        return;
+    }
+    cubeBVH.Cull(frustum, visibleCubeIndices);
+    SortVisibleCubes(eye);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
+void App::CullTerrain(const Frustum &frustum) {
+    visibleTerrainChunks.clear();
+    terrainOccluders.clear();
+    terrain.Cull(frustum, visibleTerrainChunks);
+    terrain.CullOccluders(frustum, terrainOccluders);
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cubeIndices), cubeIndices, GL_STATIC_DRAW);
+void App::CullOccludedObjects(const PhysicsSnapshot &snapshot, const glm::mat4 &viewProjection) {
+    // The occluders are the hills near the camera and the nearest cubes,
+    // which the sort has put first
+    {
+        PROFILE_ZONE("RasterizeOccluders");
+        occlusion.Begin(viewProjection);
+        glm::mat4 terrainModel = scene.WorldMatrix(terrainEntity);
+        const std::vector<uint32_t> &indices = terrain.OccluderIndices();
+        for (const std::vector<glm::vec3> *occluder : terrainOccluders) {
+            occlusion.AddOccluder(occluder->data(), occluder->size(), indices.data(), indices.size(), terrainModel);
+        }
+        size_t cubeOccluders = std::min(visibleCubeIndices.size(), MAX_CUBE_OCCLUDERS);
+        for (size_t i = 0; i < cubeOccluders; i++) {
+            occlusion.AddOccluder(CUBE_OCCLUDER_VERTICES, std::size(CUBE_OCCLUDER_VERTICES), CUBE_OCCLUDER_INDICES,
+                                  std::size(CUBE_OCCLUDER_INDICES), CubeModelMatrix(snapshot, visibleCubeIndices[i]));
+        }
+        occlusion.Rasterize(jobs);
+    }
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    PROFILE_ZONE("TestOcclusion");
+    uint32_t cubeCount = uint32_t(visibleCubeIndices.size());
+    uint8_t *cubeVisible = frameMemory.Allocate<uint8_t>(cubeCount);
+    jobs.ParallelFor(cubeCount, 1024, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            cubeVisible[i] = occlusion.IsVisible(cubeBVH.ObjectBounds(visibleCubeIndices[i]));
+        }
+    });
+    // the survivors stay front to back
+    uint32_t keptCubes = 0;
+    for (uint32_t i = 0; i < cubeCount; i++) {
+        if (cubeVisible[i]) {
+            visibleCubeIndices[keptCubes++] = visibleCubeIndices[i];
+        }
+    }
+    visibleCubeIndices.resize(keptCubes);
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    size_t hiddenChunks = std::erase_if(visibleTerrainChunks, [this](const ArenaMesh *chunk) {
+        return !occlusion.IsVisible(chunk->Bounds);
+    });
 
-    // Plane VAO
-    glGenVertexArrays(1, &planeVAO);
-    glGenBuffers(1, &planeVBO);
-    glGenBuffers(1, &planeEBO);
+    frameStats.occludedObjects = (cubeCount - keptCubes) + hiddenChunks;
+    frameStats.occluderTriangles = occlusion.TriangleCount();
+}
 
-    glBindVertexArray(planeVAO);
+void App::RecordCubeCommands(const glm::vec3 &eye) {
+    cubeCommands.Reset();
+    if (!cubeMesh.IsLoaded()) {
+        return;
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), planeVertices, GL_STATIC_DRAW);
+    uint32_t visibleCount = uint32_t(visibleCubeIndices.size());
+    cubeCommands.UploadInstanceIndices(visibleCubes, visibleCubeIndices.data(), visibleCount);
+
+    if (instancedShader && visibleCount > 0) {
+        RenderQueue::Draw draw;
+        draw.program = instancedShader;
+        draw.vao = geometry.VAO;
+        draw.material = cubeMaterial;
+        draw.depth = glm::distance(eye, cubeBVH.ObjectBounds(visibleCubeIndices[0]).Center());
+        draw.command = cubeMesh.Command(visibleCount, 0);
+        draw.positionOffset = cubeMesh.positionOffset;
+        draw.positionScale = cubeMesh.positionScale;
+        draw.positionOffsetLocation = instancedShaderPositionLocations.offset;
+        draw.positionScaleLocation = instancedShaderPositionLocations.scale;
+        cubeCommands.Draw(draw, uint64_t(cubeMesh.TriangleCount()) * visibleCount);
+    }
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, planeEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(planeIndices), planeIndices, GL_STATIC_DRAW);
+void App::RecordTerrainCommands(const glm::vec3 &eye) {
+    terrainCommands.Reset();
+    if (!shader) {
+        return;
+    }
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    glm::mat4 terrainModel = scene.WorldMatrix(terrainEntity);
+    for (const ArenaMesh *chunk : visibleTerrainChunks) {
+        RenderQueue::Draw draw;
+        draw.program = shader;
+        draw.vao = geometry.VAO;
+        draw.depth = glm::distance(eye, glm::clamp(eye, chunk->Bounds.min, chunk->Bounds.max));
+        draw.command = chunk->Command(1, 0);
+        draw.positionOffset = chunk->positionOffset;
+        draw.positionScale = chunk->positionScale;
+        draw.positionOffsetLocation = shaderPositionLocations.offset;
+        draw.positionScaleLocation = shaderPositionLocations.scale;
+        draw.instanced = false;
+        draw.modelLocation = modelLocation;
+        draw.model = terrainModel;
+        terrainCommands.Draw(draw, chunk->TriangleCount());
+    }
+}
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+glm::vec3 App::CameraPosition() const {
+    return activeCameraType == CameraType::FPS ? fpsCameraPosition.Get(renderAlpha) : arcballCamera.Position;
+}
 
+void App::StreamTerrain(bool wait) {
+    terrain.Update(CameraPosition(), TERRAIN_UPLOAD_BUDGET_SECONDS);
+    if (wait) {
+        terrain.Flush();
+    }
+}
 
-    glEnable(GL_DEPTH_TEST);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+bool App::IsDeterministic() const {
+    return headless.enabled || inputReplay.IsOpen();
 }
 
-void App::ProcessInput() {
+// Gathers the frame's events, live or from the replay (which also supplies
+// the frame's duration), records them if asked to, and handles them
+void App::ProcessInput(double &frameSeconds) {
+    frameEvents.clear();
     SDL_Event e;
-    while (SDL_PollEvent(&e)) {
-        if (e.type == SDL_QUIT) {
-            std::cout << "SDL_QUIT event triggered." << std::endl;
+    if (inputReplay.IsOpen()) {
+        if (!inputReplay.NextFrame(frameSeconds, frameEvents)) {
+            std::cout << "Input replay finished." << std::endl;
             quit = true;
+            return;
         }
-        else if (e.type == SDL_KEYDOWN) {
-            if (e.key.keysym.sym == SDLK_c) {
-                SwitchCamera();
+        // live input is ignored, but a window can still be closed
+        while (!headless.enabled && SDL_PollEvent(&e)) {
+            if (e.type == SDL_QUIT) {
+                quit = true;
             }
         }
-        else if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_RESIZED) {
-            UpdateViewport(e.window.data1, e.window.data2);
+    } else {
+        while (SDL_PollEvent(&e)) {
+            frameEvents.push_back(e);
+        }
+        if (inputRecorder.IsOpen()) {
+            inputRecorder.WriteFrame(frameSeconds, frameEvents);
         }
-        activeInputHandler->HandleInput(e, deltaTime);
     }
-}
 
-void App::Update() {
-    if (activeCameraType == CameraType::FPS) {
-        dynamic_cast<FPSInputHandler*>(activeInputHandler)->Update(deltaTime);
+    deltaTime = static_cast<float>(frameSeconds);
+    for (const SDL_Event &event : frameEvents) {
+        HandleEvent(event);
     }
 }
 
-void App::Render() {
-    // 1. Clear the screen
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+void App::HandleEvent(const SDL_Event &e) {
+    if (e.type == SDL_QUIT) {
+        std::cout << "SDL_QUIT event triggered." << std::endl;
+        quit = true;
+    }
+    else if (e.type == SDL_KEYDOWN) {
+        if (e.key.keysym.sym == SDLK_c) {
+            SwitchCamera();
+        }
+    }
+    // the offscreen target of headless runs keeps its size
+    else if (!headless.enabled && e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_RESIZED) {
+        UpdateViewport(e.window.data1, e.window.data2);
+    }
+    activeInputHandler->HandleInput(e, deltaTime);
+}
 
-    // 2. Use the shader program
-    shader->use();
+void App::Simulate(double frameSeconds) {
+    int steps = timestep.Advance(frameSeconds);
+    for (int i = 0; i < steps; ++i) {
+        Update(static_cast<float>(timestep.TickDelta()));
+    }
+    renderAlpha = timestep.Alpha();
+
+    // Only entities that changed this frame (and their children) are
+    // recomposed. That overlaps with the main thread streaming assets and
+    // terrain until Render needs the world matrices.
+    jobs.Run(sceneComposed, [this] {
+        PROFILE_ZONE("ComposeTransforms");
+        scene.Update();
+    });
+}
 
-    // 3. Set variables (uniforms) in the shaders (ex: the model, view and projection matrices)
-    // (a) Set the camera view and projection matrices
-    glm::mat4 view = (activeCameraType == CameraType::FPS)
-        ? fpsCamera.GetViewMatrix()
-        : arcballCamera.GetViewMatrix();
-    glm::mat4 projection = glm::perspective(glm::radians((activeCameraType == CameraType::FPS)
-        ? fpsCamera.Zoom
-        : arcballCamera.Zoom), (float)screenWidth / (float)screenHeight, 0.1f, 100.0f);
-    shader->setMat4("view", view);
-    shader->setMat4("projection", projection);
+void App::Update(float tickDelta) {
+    // Deterministic runs step the physics here, alongside the camera
+    JobCounter physicsStepped;
+    if (IsDeterministic()) {
+        jobs.Run(physicsStepped, [this, tickDelta] {
+            PROFILE_ZONE("PhysicsStep");
+            physics.Step(tickDelta);
+        });
+    }
 
-    // Render the cube
-    glm::mat4 model = glm::mat4(1.0f);
-    shader->setMat4("model", model);
+    activeInputHandler->Update(tickDelta);
+    fpsCameraPosition.Push(fpsCamera.Position);
+    jobs.Wait(physicsStepped);
+}
 
-    glBindVertexArray(cubeVAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+void App::Render() {
+    GLStateCache &state = GLStateCache::Get();
+    frameStats.Reset();
+    state.ResetCounters();
 
-    // Render the plane
-    model = glm::mat4(1.0f);
-    shader->setMat4("model", model);
+    // 1. Clear the screen, and move the stream buffer and the cube instances
+    // on to regions the GPU is done with
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    frameStream.BeginFrame();
+    cubeInstanceBuffer.BeginFrame();
+
+    // 2. Bring the camera matrices up to date and upload them once for every
+    // program. The FPS camera moves in simulation ticks; render it between
+    // the last two so motion stays smooth whatever the frame rate. The
+    // matrices, uniforms and frustum are only rebuilt when the camera moved
+    CameraMatrices &camera = (activeCameraType == CameraType::FPS)
+        ? fpsCamera.Matrices(fpsCameraPosition.Get(renderAlpha))
+        : arcballCamera.Matrices();
+    if (&camera != uploadedCamera || camera.Version() != uploadedCameraVersion) {
+        cameraUniforms.Upload(camera.View(), camera.Projection());
+        cameraFrustum = Frustum::FromMatrix(camera.ViewProjection());
+        uploadedCamera = &camera;
+        uploadedCameraVersion = camera.Version();
+    }
+    const Frustum &frustum = cameraFrustum;
+    glm::vec3 eye = camera.Eye();
+
+    // 3. Record the frame's draws as a job graph on the job threads. The
+    // cube bounds are refitted to the latest physics snapshot, and the cubes
+    // and terrain chunks culled against the frustum, the terrain once the
+    // scene transforms are composed. Then the nearby hills and cubes are
+    // rasterized as occluders, whatever they hide is dropped, and the rest
+    // is recorded into a command list per partition. Meanwhile this thread,
+    // which owns the GL context, writes the moved cubes' transforms into the
+    // instance buffer with the job threads' help.
+    const PhysicsSnapshot &snapshot = physics.LatestSnapshot();
+    const glm::mat4 &viewProjection = camera.ViewProjection();
+    JobCounter frustumCulled, occlusionCulled, recorded;
+    jobs.Run(frustumCulled, [this, &snapshot, &frustum, eye] {
+        PROFILE_ZONE("CullCubes");
+        CullCubes(snapshot, frustum, eye);
+    });
+    jobs.Run(frustumCulled, [this, &frustum] {
+        PROFILE_ZONE("CullTerrain");
+        CullTerrain(frustum);
+    }, &sceneComposed);
+    jobs.Run(occlusionCulled, [this, &snapshot, &viewProjection] {
+        PROFILE_ZONE("CullOccluded");
+        CullOccludedObjects(snapshot, viewProjection);
+    }, &frustumCulled);
+    jobs.Run(recorded, [this, eye] {
+        PROFILE_ZONE("RecordCubes");
+        RecordCubeCommands(eye);
+    }, &occlusionCulled);
+    jobs.Run(recorded, [this, eye] {
+        PROFILE_ZONE("RecordTerrain");
+        RecordTerrainCommands(eye);
+    }, &occlusionCulled);
+    UploadPhysicsTransforms(snapshot);
+
+    // 4. Replay the command lists, merging their draws into one queue, and
+    // submit them sorted by state, then front to back. All meshes share the
+    // geometry arena, so instanced draws with the same program and material
+    // go out as one multi-draw. Every counter is waited for, so none goes
+    // away while a job still holds it.
+    jobs.Wait(frustumCulled);
+    jobs.Wait(occlusionCulled);
+    jobs.Wait(recorded);
+    renderQueue.Clear(FAR_PLANE);
+    CommandList *commandLists[] = {&cubeCommands, &terrainCommands};
+    frameStats.triangles += ReplayCommandLists(commandLists, std::size(commandLists), renderQueue);
+
+    if (!renderQueue.Empty()) {
+        ScopedGpuZone gpuZone(gpuTimer, "Opaque");
+        renderQueue.Sort();
+        frameStats.drawCalls += renderQueue.Submit(indirectDraws, visibleCubes);
+    }
+    frameStream.EndFrame();
+    cubeInstanceBuffer.EndFrame();
 
-    glBindVertexArray(planeVAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    frameStats.stateChanges = state.GetCounters().issued;
+    frameStats.stateChangesElided = state.GetCounters().elided;
+    frameStats.frameMemoryBytes = frameMemory.BytesUsed();
+    frameStats.frameMemoryHeapBytes = frameMemory.OverflowBytes();
 }
 
 void App::SwitchCamera() {
@@ -247,7 +954,7 @@ void App::SwitchCamera() {
         arcballCamera.Distance = glm::distance(fpsCamera.Position, arcballCamera.Target);
 
         activeCameraType = CameraType::Arcball;
-        activeInputHandler = arcballInputHandler;
+        activeInputHandler = &arcballInputHandler;
 
         SDL_SetRelativeMouseMode(SDL_FALSE);
     } else {
@@ -257,8 +964,10 @@ void App::SwitchCamera() {
         fpsCamera.Yaw = glm::degrees(atan2(fpsCamera.Front.z, fpsCamera.Front.x));
         fpsCamera.Pitch = glm::degrees(asin(fpsCamera.Front.y));
 
+        fpsCameraPosition.Reset(fpsCamera.Position);
+
         activeCameraType = CameraType::FPS;
-        activeInputHandler = fpsInputHandler;
+        activeInputHandler = &fpsInputHandler;
 
         SDL_SetRelativeMouseMode(SDL_TRUE);
     }
@@ -268,18 +977,41 @@ void App::UpdateViewport(const int &width, const int &height) {
     screenWidth = width;
     screenHeight = height;
     glViewport(0, 0, screenWidth, screenHeight);
+
+    float aspectRatio = (float)screenWidth / (float)screenHeight;
+    fpsCamera.SetProjection(aspectRatio, NEAR_PLANE, FAR_PLANE);
+    arcballCamera.SetProjection(aspectRatio, NEAR_PLANE, FAR_PLANE);
 }
 
 void App::CleanUp() {
-    glDeleteVertexArrays(1, &cubeVAO);
-    glDeleteBuffers(1, &cubeVBO);
-    glDeleteBuffers(1, &cubeEBO);
-
-    glDeleteVertexArrays(1, &planeVAO);
-    glDeleteBuffers(1, &planeVBO);
-    glDeleteBuffers(1, &planeEBO);
+    jobs.Wait(sceneComposed);
+    jobs.Stop();
+    physics.Stop();
+    assets.Stop();
+    terrain.Stop();
+
+    geometry.Destroy();
+    cubeInstanceBuffer.Destroy();
+    visibleCubes.Destroy();
+    frameStream.Destroy();
+    cameraUniforms.Destroy();
+    gpuTimer.Destroy();
+
+    programs.Destroy(shader);
+    programs.Destroy(instancedShader);
+
+    if (headless.enabled) {
+        glDeleteFramebuffers(1, &offscreenFBO);
+        glDeleteRenderbuffers(1, &offscreenColorRBO);
+        glDeleteRenderbuffers(1, &offscreenDepthRBO);
+#ifdef APP_HAS_EGL
+        eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(eglDisplay, eglContext);
+        eglTerminate(eglDisplay);
+#endif
+        return;
+    }
 
-    delete shader;
     SDL_GL_DeleteContext(context);
     SDL_DestroyWindow(window);
     SDL_Quit();
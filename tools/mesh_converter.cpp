@@ -0,0 +1,248 @@
+// Offline converter from Wavefront OBJ to the binary .mesh format loaded by
+// MappedMesh (see include/mesh/mesh_format.hpp).
+//
+//   mesh_converter [--format float|snorm16|half] <input.obj> <output.mesh>
+//
+// Supported OBJ subset: "v x y z [r g b]" (the common vertex color
+// extension; vertices without a color are white) and "f" with any of the
+// v, v/vt, v//vn, v/vt/vn index forms, including negative indices. Polygons
+// are triangulated as fans. Texture coordinates and normals are ignored, so
+// a vertex is identified by its position index alone; vertex normals are
+// computed from the faces around it.
+//
+// The format selects the vertex layout (see include/mesh/vertex_format.hpp):
+// float is MeshVertexLayout::PositionColor, snorm16 (the default) and half
+// the 16-byte quantized layouts with normals.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "mesh/mesh_format.hpp"
+
+struct ObjVertex {
+    float position[3];
+    float color[3];
+    float normal[3];
+};
+
+static bool ParseObj(const char *path, std::vector<ObjVertex> &vertices, std::vector<uint32_t> &indices) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "ERROR::MESH_CONVERTER::CANNOT_OPEN " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+
+        if (keyword == "v") {
+            ObjVertex vertex = {{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, 0.0f, 0.0f}};
+            tokens >> vertex.position[0] >> vertex.position[1] >> vertex.position[2];
+            if (!tokens) {
+                std::cerr << path << ":" << lineNumber << ": malformed vertex" << std::endl;
+                return false;
+            }
+            float r, g, b;
+            if (tokens >> r >> g >> b) {
+                vertex.color[0] = r;
+                vertex.color[1] = g;
+                vertex.color[2] = b;
+            }
+            vertices.push_back(vertex);
+        } else if (keyword == "f") {
+            std::vector<uint32_t> polygon;
+            std::string corner;
+            while (tokens >> corner) {
+                // only the position index matters; drop "/vt/vn"
+                long index = std::strtol(corner.c_str(), nullptr, 10);
+                long resolved = index < 0 ? long(vertices.size()) + index : index - 1;
+                if (index == 0 || resolved < 0 || resolved >= long(vertices.size())) {
+                    std::cerr << path << ":" << lineNumber << ": face index out of range" << std::endl;
+                    return false;
+                }
+                polygon.push_back(uint32_t(resolved));
+            }
+            if (polygon.size() < 3) {
+                std::cerr << path << ":" << lineNumber << ": face with fewer than 3 vertices" << std::endl;
+                return false;
+            }
+            for (size_t i = 1; i + 1 < polygon.size(); i++) {
+                indices.push_back(polygon[0]);
+                indices.push_back(polygon[i]);
+                indices.push_back(polygon[i + 1]);
+            }
+        }
+        // everything else (vt, vn, o, g, s, usemtl, mtllib, comments) is ignored
+    }
+
+    if (vertices.empty() || indices.empty()) {
+        std::cerr << "ERROR::MESH_CONVERTER::EMPTY_MESH " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Area-weighted average of the normals of the faces around each vertex
+static void ComputeNormals(std::vector<ObjVertex> &vertices, const std::vector<uint32_t> &indices) {
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const float *a = vertices[indices[i]].position;
+        const float *b = vertices[indices[i + 1]].position;
+        const float *c = vertices[indices[i + 2]].position;
+        float ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        float ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        // the cross product's length is twice the face area
+        float n[3] = {ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0]};
+        for (int corner = 0; corner < 3; corner++) {
+            float *normal = vertices[indices[i + corner]].normal;
+            for (int axis = 0; axis < 3; axis++) {
+                normal[axis] += n[axis];
+            }
+        }
+    }
+    for (ObjVertex &vertex : vertices) {
+        float *n = vertex.normal;
+        float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length > 0.0f) {
+            n[0] /= length;
+            n[1] /= length;
+            n[2] /= length;
+        } else {
+            n[0] = 0.0f;
+            n[1] = 1.0f;
+            n[2] = 0.0f;
+        }
+    }
+}
+
+// Chooses the per-mesh dequantization and fills the vertex block
+static std::vector<uint8_t> EncodeVertices(MeshFileHeader &header, const std::vector<ObjVertex> &vertices) {
+    float center[3], halfExtent[3];
+    for (int axis = 0; axis < 3; axis++) {
+        center[axis] = 0.5f * (header.boundsMin[axis] + header.boundsMax[axis]);
+        halfExtent[axis] = 0.5f * (header.boundsMax[axis] - header.boundsMin[axis]);
+    }
+    ChooseDequantization(header.vertexLayout, center, halfExtent, header.positionOffset, header.positionScale);
+
+    const VertexFormat &format = GetVertexFormat(header.vertexLayout);
+    std::vector<uint8_t> block(uint64_t(format.stride) * vertices.size(), 0);
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const ObjVertex &vertex = vertices[i];
+        float stored[3];
+        for (int axis = 0; axis < 3; axis++) {
+            float scale = header.positionScale[axis];
+            float relative = vertex.position[axis] - header.positionOffset[axis];
+            stored[axis] = scale != 0.0f ? relative / scale : 0.0f;
+        }
+        WriteVertex(format, block.data() + i * format.stride, stored, vertex.normal, vertex.color);
+    }
+    return block;
+}
+
+static void WritePadding(std::ofstream &out, uint64_t offset) {
+    static const char zeros[MESH_BLOCK_ALIGNMENT] = {};
+    uint64_t position = uint64_t(out.tellp());
+    out.write(zeros, std::streamsize(offset - position));
+}
+
+static bool WriteMesh(const char *path, MeshVertexLayout layout, const std::vector<ObjVertex> &vertices,
+                      const std::vector<uint32_t> &indices) {
+    MeshFileHeader header = {};
+    header.magic = MESH_MAGIC;
+    header.version = MESH_VERSION;
+    header.vertexLayout = layout;
+    header.vertexStride = MeshVertexStride(header.vertexLayout);
+    header.vertexCount = uint32_t(vertices.size());
+    header.indexCount = uint32_t(indices.size());
+    // 32-bit, the width of the geometry arena's index buffer, so the block
+    // uploads without conversion
+    header.indexSize = sizeof(uint32_t);
+    header.vertexBytes = uint64_t(header.vertexStride) * header.vertexCount;
+    header.indexBytes = uint64_t(header.indexSize) * header.indexCount;
+    header.vertexOffset = AlignMeshOffset(sizeof(MeshFileHeader));
+    header.indexOffset = AlignMeshOffset(header.vertexOffset + header.vertexBytes);
+
+    for (int axis = 0; axis < 3; axis++) {
+        header.boundsMin[axis] = vertices[0].position[axis];
+        header.boundsMax[axis] = vertices[0].position[axis];
+    }
+    for (const ObjVertex &vertex : vertices) {
+        for (int axis = 0; axis < 3; axis++) {
+            header.boundsMin[axis] = std::min(header.boundsMin[axis], vertex.position[axis]);
+            header.boundsMax[axis] = std::max(header.boundsMax[axis], vertex.position[axis]);
+        }
+    }
+
+    std::vector<uint8_t> vertexBlock = EncodeVertices(header, vertices);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "ERROR::MESH_CONVERTER::CANNOT_WRITE " << path << std::endl;
+        return false;
+    }
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    WritePadding(out, header.vertexOffset);
+    out.write(reinterpret_cast<const char *>(vertexBlock.data()), std::streamsize(header.vertexBytes));
+
+    WritePadding(out, header.indexOffset);
+    out.write(reinterpret_cast<const char *>(indices.data()), std::streamsize(header.indexBytes));
+
+    if (!out) {
+        std::cerr << "ERROR::MESH_CONVERTER::CANNOT_WRITE " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool ParseFormat(const std::string &name, MeshVertexLayout &layout) {
+    if (name == "float") {
+        layout = MeshVertexLayout::PositionColor;
+    } else if (name == "snorm16") {
+        layout = MeshVertexLayout::Snorm16PositionNormalColor;
+    } else if (name == "half") {
+        layout = MeshVertexLayout::HalfPositionNormalColor;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    MeshVertexLayout layout = MeshVertexLayout::Snorm16PositionNormalColor;
+    int first = 1;
+    if (argc == 5 && std::strcmp(argv[1], "--format") == 0 && ParseFormat(argv[2], layout)) {
+        first = 3;
+    } else if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " [--format float|snorm16|half] <input.obj> <output.mesh>" << std::endl;
+        return 1;
+    }
+    const char *input = argv[first];
+    const char *output = argv[first + 1];
+
+    std::vector<ObjVertex> vertices;
+    std::vector<uint32_t> indices;
+    if (!ParseObj(input, vertices, indices)) {
+        return 1;
+    }
+    ComputeNormals(vertices, indices);
+    if (!WriteMesh(output, layout, vertices, indices)) {
+        return 1;
+    }
+
+    std::cout << output << ": " << vertices.size() << " vertices, " << indices.size() / 3 << " triangles, "
+              << MeshVertexStride(layout) << " bytes per vertex" << std::endl;
+    return 0;
+}